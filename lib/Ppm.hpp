@@ -227,7 +227,7 @@ public:
     [[nodiscard]] double max_rgb_value() const {
         auto max = 0.0;
         for (auto v : img) {
-            max = std::max(std::max(std::max(v[0], v[1]), v[2]), max);
+            max = std::max<double>(std::max(std::max(v[0], v[1]), v[2]), max);
         }
 
         return max;
@@ -236,7 +236,7 @@ public:
     [[nodiscard]] double max_v_value() const {
         double max = 0.0;
         for (auto v : img) {
-            max = std::max(v[2], max);
+            max = std::max<double>(v[2], max);
         }
 
         return max;
@@ -22,6 +22,8 @@
 #include "PointLight.hpp"
 #include "camera.hpp"
 #include "ObjMod.hpp"
+#include "MeshSimplification.hpp"
+#include "Triangle.hpp"
 #include "Sphere.hpp"
 #include "Cylinder.hpp"
 #include "Cone.hpp"
@@ -33,11 +35,27 @@
 
 class Scene {
 public:
-    std::vector<std::shared_ptr<Figure>> figures;
+    std::vector<std::shared_ptr<Figure>> figures; // Figures added after building the scene go through add_figure
     std::vector<PointLight> point_lights;
     Camera camera;
+    MaterialTable materials; // Of every figure, looked up by the material id of the hits
 
-    explicit Scene(std::vector<std::shared_ptr<Figure>> _figures, std::vector<PointLight> _point_lights, Camera _camera) : figures(std::move(_figures)), point_lights(std::move(_point_lights)), camera(_camera) {}
+    explicit Scene(std::vector<std::shared_ptr<Figure>> _figures, std::vector<PointLight> _point_lights, Camera _camera) : figures(std::move(_figures)), point_lights(std::move(_point_lights)), camera(_camera) {
+        for (const auto &figure : figures) figure->register_materials(materials);
+    }
+
+    void add_figure(std::shared_ptr<Figure> figure) {
+        figure->register_materials(materials);
+        figures.push_back(std::move(figure));
+    }
+
+    // Level of detail: simplifies every mesh of the scene to the triangles needed by its size on screen (see
+    // MeshSimplification.hpp). Must be called before building the acceleration structures
+    void simplify_meshes(double triangles_per_pixel = LOD_TRIANGLES_PER_PIXEL) {
+        for (const auto &figure : figures) {
+            if (auto mesh = std::dynamic_pointer_cast<TriangleMesh>(figure)) simplify_mesh(*mesh, camera, triangles_per_pixel);
+        }
+    }
 
     static Scene cornell_box_area_light(size_t width, size_t height, size_t rays_per_pixel) {
         Point O(0, 0, -3.5);
@@ -419,38 +437,25 @@ public:
                       tr_reflection_coefficient,
                       tr_refraction_index);
 
-        Cylinder cilindro(Point(0.8,-0.4,-0.15), 0.3, 0.4,
-                          Vector3d(0.3, 0.5, 0.7),
-                          tr_refraction_coefficient,
-                          tr_reflection_coefficient,
-                          tr_refraction_index);
+        // Cylinder rotated pi/2 on the Y axis
+        Cylinder cilindroGirado(Point(-0.15,-0.4,-0.8), Direction(-1, 0, 0), 0.3, 0.4, false,
+                                Vector3d(0.3, 0.5, 0.7),
+                                tr_refraction_coefficient,
+                                tr_reflection_coefficient,
+                                tr_refraction_index);
 
-        TransformationMatrix m = TransformationMatrix::RotationMatrixOnY(M_PI/2);
-        TransformationMatrix m1 = TransformationMatrix::RotationMatrixOnZ(M_PI/2);
-
-        TransformedFigure cilindroGirado = TransformedFigure(m, std::make_shared<Cylinder>(cilindro),
-                                              Vector3d(0.3, 0.5, 0.7),
-                                            tr_refraction_coefficient,
-                                            tr_reflection_coefficient,
-                                                tr_refraction_index);
-
-        Cone cono(Point(-0.5,-0.3, 0.55), 0.5,
-                  Vector3d(0.3, 0.5, 0.7),
-                  tr_refraction_coefficient,
-                  tr_reflection_coefficient,
-                  tr_refraction_index);
-
-        TransformedFigure conoGirado = TransformedFigure(m1*m, std::make_shared<Cone>(cono),
-                Vector3d(0.3, 0.3, 0.7),
-                tr_refraction_coefficient,
-                tr_reflection_coefficient,
-                tr_refraction_index);
+        // Cone rotated pi/2 on the Y axis and then pi/2 on the Z axis
+        Cone conoGirado(Point(0.3,0.55, 0.5), Direction(0, -1, 0), 0.5, 0.5, false,
+                        Vector3d(0.3, 0.5, 0.7),
+                        tr_refraction_coefficient,
+                        tr_reflection_coefficient,
+                        tr_refraction_index);
 
 
         std::vector<std::shared_ptr<Figure>> figures;
 
-        figures.push_back(std::make_shared<TransformedFigure>(cilindroGirado));
-        figures.push_back(std::make_shared<TransformedFigure>(conoGirado));
+        figures.push_back(std::make_shared<Cylinder>(cilindroGirado));
+        figures.push_back(std::make_shared<Cone>(conoGirado));
         figures.push_back(std::make_shared<Ellipsoid>(ellipsoid));
         figures.push_back(std::make_shared<Sphere>(s_left));
         figures.push_back(std::make_shared<Plane>(left_plane));
@@ -530,23 +535,16 @@ public:
         Vector3d tr_reflection_coefficient(1, 1, 1);
         double tr_refraction_index = 1;
 
-        Cylinder cilindro(Point(0,0,0.5), 0.3, 1,
-                          Vector3d(0.3, 0.5, 0.7),
-                          tr_refraction_coefficient,
-                          tr_reflection_coefficient,
-                          tr_refraction_index);
-
-        TransformationMatrix m = TransformationMatrix::RotationMatrixOnX(M_PI/2);
-
-        TransformedFigure cilindroGirado = TransformedFigure(m, std::make_shared<Cylinder>(cilindro),
-                                                             Vector3d(0.3, 0.5, 0.7),
-                                                             tr_refraction_coefficient,
-                                                             tr_reflection_coefficient,
-                                                             tr_refraction_index);
+        // Cylinder rotated pi/2 on the X axis
+        Cylinder cilindroGirado(Point(0,-0.5,0), Direction(0, 1, 0), 0.3, 1, false,
+                                Vector3d(0.3, 0.5, 0.7),
+                                tr_refraction_coefficient,
+                                tr_reflection_coefficient,
+                                tr_refraction_index);
 
 
         std::vector<std::shared_ptr<Figure>> figures;
-        figures.push_back(std::make_shared<TransformedFigure>(cilindroGirado));
+        figures.push_back(std::make_shared<Cylinder>(cilindroGirado));
         figures.push_back(std::make_shared<Plane>(left_plane));
         figures.push_back(std::make_shared<Plane>(right_plane));
         figures.push_back(std::make_shared<Plane>(floor_plane));
@@ -578,22 +576,15 @@ public:
         Vector3d tr_reflection_coefficient(1, 1, 1);
         double tr_refraction_index = 1;
 
-        Cone cono(Point(0,0,0.5), .8,
-                          Vector3d(0.3, 0.5, 0.7),
-                          tr_refraction_coefficient,
-                          tr_reflection_coefficient,
-                          tr_refraction_index);
-
-        TransformationMatrix m = TransformationMatrix::RotationMatrixOnX(M_PI/2);
-        m = m * TransformationMatrix::RotationMatrixOnY(M_PI) ;
-        TransformedFigure conoGirado = TransformedFigure(m, std::make_shared<Cone>(cono),
-                                                             Vector3d(0.3, 0.5, 0.7),
-                                                             tr_refraction_coefficient,
-                                                             tr_reflection_coefficient,
-                                                             tr_refraction_index);
+        // Cone rotated pi on the Y axis and then pi/2 on the X axis
+        Cone conoGirado(Point(0,0.5,0), Direction(0, -1, 0), .8, .8, false,
+                        Vector3d(0.3, 0.5, 0.7),
+                        tr_refraction_coefficient,
+                        tr_reflection_coefficient,
+                        tr_refraction_index);
 
         std::vector<std::shared_ptr<Figure>> figures;
-        figures.push_back(std::make_shared<TransformedFigure>(conoGirado));
+        figures.push_back(std::make_shared<Cone>(conoGirado));
         figures.push_back(std::make_shared<Plane>(left_plane));
         figures.push_back(std::make_shared<Plane>(right_plane));
         figures.push_back(std::make_shared<Plane>(floor_plane));
@@ -808,7 +799,7 @@ public:
         Plane floor_plane(1, Direction(0, 1.045, 0), Vector3d(0.6, 0.6, 0.6), Vector3d(0, 0, 0), Vector3d(0.2, 0.2, 0.2), 1.0, chevron_texture);
         Plane ceiling_plane_above_light(1, Direction(0, -1, 0), Vector3d(146.0/255.0, 0, 2.0/255.0), Vector3d(0, 0, 0), Vector3d(0, 0, 0), 1.0); // Luz de área
         Plane ceiling_plane(1, Direction(0, -1, 0), Vector3d(1, 1, 1)); // Luz de área
-        ceiling_plane.set_bounds(Point(-0.5, 0.99, -0.75), Point(0.5, 1.01, std::numeric_limits<double>::max()));
+        ceiling_plane.set_bounds(Point(-0.5, 0.99, -0.75), Point(0.5, 1.01, std::numeric_limits<Real>::max()));
         Plane back_plane(1, Direction(0, 0, -1), Vector3d(127.0 / 255.0, 42.0 / 255.0, 60.0 / 255.0), Vector3d(0, 0, 0), Vector3d(0, 0, 0), 1.0); // "Red velvet"
 
         Vector3d tr_diffuse_coefficient(0, 0, 0); // "Black"
@@ -816,57 +807,41 @@ public:
         Vector3d tr_reflection_coefficient(0.1, 0.1, 0.1);
         double tr_refraction_index = 1.56; // Softwood
         std::vector<std::shared_ptr<Figure>> figures;
-        auto triangulos = load_obj("objs/final2/lamparamesilla.obj", Vector3d(189.0 / 255.0, 243.0 / 255.0, 226.0 / 255.0), Vector3d(0.15, 0.15, 0.15),
-                                   Vector3d(0.15, 0.15, 0.15), tr_refraction_index);
-        for (const auto& triangulo : triangulos) {
-            figures.push_back(std::make_shared<Triangle>(triangulo));
-        }
+        figures.push_back(load_obj("objs/final2/lamparamesilla.obj", Vector3d(189.0 / 255.0, 243.0 / 255.0, 226.0 / 255.0), Vector3d(0.15, 0.15, 0.15),
+                                   Vector3d(0.15, 0.15, 0.15), tr_refraction_index));
 
-        triangulos = load_obj("objs/final2/sofa.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                                   tr_reflection_coefficient, tr_refraction_index);
-        for (const auto& triangulo : triangulos) {
-            figures.push_back(std::make_shared<Triangle>(triangulo));
-        }
+        figures.push_back(load_obj("objs/final2/sofa.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                                   tr_reflection_coefficient, tr_refraction_index));
 
         tr_diffuse_coefficient = Vector3d(142.0 / 255.0, 142.0 / 255.0, 142.0 / 255.0); // "Gris metálico"
         tr_refraction_coefficient = Vector3d(0.15, 0.15, 0.15);
         tr_reflection_coefficient = Vector3d(0.25, 0.25, 0.25);
         tr_refraction_index = 2.6112; // Titanio
-        triangulos = load_obj("objs/final2/lampara.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                                   tr_reflection_coefficient, tr_refraction_index);
-        for (const auto& triangulo : triangulos) {
-            figures.push_back(std::make_shared<Triangle>(triangulo));
-        }
+        figures.push_back(load_obj("objs/final2/lampara.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                                   tr_reflection_coefficient, tr_refraction_index));
 
         tr_diffuse_coefficient = Vector3d(245 / 255.0, 247 / 255.0, 247 / 255.0); // "Marble"
         tr_refraction_coefficient = Vector3d(0.04, 0.04, 0.04);
         tr_reflection_coefficient = Vector3d(0.04, 0.04, 0.04);
         tr_refraction_index = 1.486; // Marble
-        triangulos = load_obj("objs/final2/venus6.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                              tr_reflection_coefficient, tr_refraction_index, venus_texture);
-        for (const auto& triangulo : triangulos)
-            figures.push_back(std::make_shared<Triangle>(triangulo));
+        figures.push_back(load_obj("objs/final2/venus6.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                              tr_reflection_coefficient, tr_refraction_index, venus_texture));
 
 
         tr_diffuse_coefficient = Vector3d(127.0 / 255.0, 42.0 / 255.0, 60.0 / 255.0); // "Red velvet"
         tr_refraction_coefficient = Vector3d(0, 0, 0);
         tr_reflection_coefficient = Vector3d(0, 0, 0);
         tr_refraction_index = 1;
-        triangulos = load_obj("objs/final2/cortinas_todo.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                              tr_reflection_coefficient, tr_refraction_index);
-        for (const auto& triangulo : triangulos)
-            figures.push_back(std::make_shared<Triangle>(triangulo));
+        figures.push_back(load_obj("objs/final2/cortinas_todo.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                              tr_reflection_coefficient, tr_refraction_index));
 
 
         tr_diffuse_coefficient = Vector3d(130.0 /255, 135.0 / 255, 135.0 / 255); // "Black"
         tr_refraction_coefficient = Vector3d(0.2, 0.2, 0.2);
         tr_reflection_coefficient = Vector3d(0.2, 0.2, 0.2);
         tr_refraction_index = 1.1978; // Aluminio
-        triangulos = load_obj("objs/final2/mesilla.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                                   tr_reflection_coefficient, tr_refraction_index);
-        for (const auto& triangulo : triangulos) {
-            figures.push_back(std::make_shared<Triangle>(triangulo));
-        }
+        figures.push_back(load_obj("objs/final2/mesilla.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                                   tr_reflection_coefficient, tr_refraction_index));
 
         /*Cylinder cilindro(Point(1, 0, 1), 0.15, 0.6,
                           Vector3d(127.0 / 255.0, 42.0 / 255.0, 60.0 / 255.0),
@@ -965,12 +940,12 @@ public:
                            tr_reflection_coefficient,
                            tr_refraction_index);
         TransformationMatrix m1 = TransformationMatrix::RotationMatrixOnY(M_PI/2);
-        TransformationMatrix m2 = TransformationMatrix::RotationMatrixOnX(M_PI/2);
-        TransformedFigure cilindroGirado1 = TransformedFigure(m2, std::make_shared<Cylinder>(cilindro),
-                                                              Vector3d(0.3, 0.5, 0.7),
-                                                              tr_refraction_coefficient,
-                                                              tr_reflection_coefficient,
-                                                              tr_refraction_index);
+        // cilindro rotated pi/2 on the X axis
+        Cylinder cilindroGirado1(Point(0,-0.35,-0.4), Direction(0, 1, 0), 0.2, 0.7, false,
+                                 Vector3d(0.3, 0.5, 0.7),
+                                 tr_refraction_coefficient,
+                                 tr_reflection_coefficient,
+                                 tr_refraction_index);
         TransformationMatrix m3 = TransformationMatrix::ScaleMatrix(1,2,1);
         TransformedFigure cilindroGirado1Grande = TransformedFigure(m3, std::make_shared<Cylinder>(cilindro),
                                                                     Vector3d(0.3, 0.5, 0.7),
@@ -978,7 +953,7 @@ public:
                                                                     tr_reflection_coefficient,
                                                                     tr_refraction_index);
 
-        ConstructiveSolidUnion unionCilindros(std::make_shared<TransformedFigure>(cilindroGirado1),std::make_shared<Cylinder>(cilindro2));
+        ConstructiveSolidUnion unionCilindros(std::make_shared<Cylinder>(cilindroGirado1),std::make_shared<Cylinder>(cilindro2));
 
         Sphere circ(Point(0,0,0.35), 0.7,
                     Vector3d(0.3, 0.5, 0.7),
@@ -1031,10 +1006,8 @@ public:
         Vector3d tr_reflection_coefficient(0.06, 0.06, 0.06);
         double tr_refraction_index = 1.5;
         std::vector<std::shared_ptr<Figure>> figures;
-        auto triangulos = load_obj("objs/modelos_finales/dragon.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                                   tr_reflection_coefficient, tr_refraction_index);
-        for (const auto& triangulo : triangulos)
-            figures.push_back(std::make_shared<Triangle>(triangulo));
+        figures.push_back(load_obj("objs/modelos_finales/dragon.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                                   tr_reflection_coefficient, tr_refraction_index));
 
         figures.push_back(std::make_shared<Plane>(left_plane));
         figures.push_back(std::make_shared<Plane>(right_plane));
@@ -1066,13 +1039,11 @@ public:
 
         double tr_refraction_index = 1.5;
         std::vector<std::shared_ptr<Figure>> figures;
-        auto triangulos = load_obj("objs/modelos_finales/dragon.obj",
+        figures.push_back(load_obj("objs/modelos_finales/dragon.obj",
                                    Vector3d(0, 0, 0),
                                    Vector3d(0.85, 0.85, 0.85),
                                    Vector3d(0.1, 0.1, 0.1),
-                                   tr_refraction_index);
-        for (const auto& triangulo : triangulos)
-            figures.push_back(std::make_shared<Triangle>(triangulo));
+                                   tr_refraction_index));
 
         figures.push_back(std::make_shared<Plane>(left_plane));
         figures.push_back(std::make_shared<Plane>(right_plane));
@@ -1107,10 +1078,8 @@ public:
         Vector3d tr_reflection_coefficient(0.03, 0.03, 0.03);
         double tr_refraction_index = 1.5;
         std::vector<std::shared_ptr<Figure>> figures;
-        auto triangulos = load_obj("objs/modelos_finales/dragon.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                                   tr_reflection_coefficient, tr_refraction_index, texture);
-        for (const auto& triangulo : triangulos)
-            figures.push_back(std::make_shared<Triangle>(triangulo));
+        figures.push_back(load_obj("objs/modelos_finales/dragon.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                                   tr_reflection_coefficient, tr_refraction_index, texture));
 
         figures.push_back(std::make_shared<Plane>(left_plane));
         figures.push_back(std::make_shared<Plane>(right_plane));
@@ -1222,10 +1191,8 @@ public:
         Vector3d tr_reflection_coefficient(0.03, 0.03, 0.03);
         double tr_refraction_index = 1.5;
         std::vector<std::shared_ptr<Figure>> figures;
-        auto triangulos = load_obj("objs/modelos_finales/dragon.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
-                                   tr_reflection_coefficient, tr_refraction_index, texture);
-        for (const auto& triangulo : triangulos)
-            figures.push_back(std::make_shared<Triangle>(triangulo));
+        figures.push_back(load_obj("objs/modelos_finales/dragon.obj", tr_diffuse_coefficient, tr_refraction_coefficient,
+                                   tr_reflection_coefficient, tr_refraction_index, texture));
 
         figures.push_back(std::make_shared<Plane>(left_plane));
         figures.push_back(std::make_shared<Plane>(right_plane));
@@ -15,6 +15,7 @@
 
 
 #include "benchmarking.hpp"
+#include "HitRegister.hpp"
 
 void Benchmarking::print_statistics() {
     std::cout << "Statistics:" << std::endl;
@@ -22,6 +23,13 @@ void Benchmarking::print_statistics() {
     std::cout << "\tFigures tested for collision: " << Benchmarking::figures_checked << std::endl;
     std::cout << "\tBounds tested for collision: " << Benchmarking::bounds_checked << std::endl;
 
+    // Hits are returned by value at every BVH node and for every primitive tested
+    double hit_records_per_ray = Benchmarking::light_rays_traced == 0 ? 0 :
+                                 (double) Benchmarking::hit_records_returned / (double) Benchmarking::light_rays_traced;
+    std::cout << "\tHit records returned during traversal: " << Benchmarking::hit_records_returned << " ("
+              << hit_records_per_ray * sizeof(TraversalHit) << " bytes per ray, "
+              << hit_records_per_ray * sizeof(HitRegister) << " if they were full hit registers)" << std::endl;
+
     auto secs = std::chrono::duration_cast<std::chrono::seconds>(Benchmarking::median_time_for_n_rays);
     Benchmarking::median_time_for_n_rays -= std::chrono::duration_cast<std::chrono::milliseconds>(secs);
 
@@ -53,4 +61,10 @@ void  Benchmarking::count_bounds_checked() {
     std::unique_lock<std::mutex> lock(Benchmarking::mutex);
 
     ++Benchmarking::bounds_checked;
+}
+
+void  Benchmarking::count_hit_record_returned() {
+    std::unique_lock<std::mutex> lock(Benchmarking::mutex);
+
+    ++Benchmarking::hit_records_returned;
 }
\ No newline at end of file
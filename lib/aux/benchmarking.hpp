@@ -27,6 +27,7 @@ namespace Benchmarking {
     inline unsigned long light_rays_traced = 0;
     inline unsigned long figures_checked = 0;
     inline unsigned long bounds_checked = 0;
+    inline unsigned long hit_records_returned = 0;
     inline std::chrono::milliseconds median_time_for_n_rays = std::chrono::milliseconds(0);
     inline unsigned long light_rays_per_median_time = 0;
 
@@ -34,6 +35,7 @@ namespace Benchmarking {
     void count_ray_traced();
     void count_figure_checked();
     void count_bounds_checked();
+    void count_hit_record_returned();
 }
 
 #endif //INFORMATICA_GRAFICA_BENCHMARKING_HPP
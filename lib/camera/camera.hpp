@@ -19,6 +19,7 @@
 #include "../math/Direction.hpp"
 #include "../math/Point.hpp"
 #include "../Ray.hpp"
+#include <random>
 #include <vector>
 
 class Camera {
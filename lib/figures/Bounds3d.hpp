@@ -32,8 +32,8 @@ public:
     Point p_min, p_max;
 
     Bounds3d() {
-        double minNum = std::numeric_limits<double>::lowest();
-        double maxNum = std::numeric_limits<double>::max();
+        Real minNum = std::numeric_limits<Real>::lowest();
+        Real maxNum = std::numeric_limits<Real>::max();
         p_min = Point(maxNum, maxNum, maxNum);
         p_max = Point(minNum, minNum, minNum);
     }
@@ -69,6 +69,27 @@ public:
                       std::max(p_max[2], b.p_max[2]))};
     }
 
+    // Returns the Bounding box shared by itself and the given Bounding box (empty if they don't overlap)
+    [[nodiscard]] Bounds3d Intersection(const Bounds3d &b) const {
+        return {Point(std::max(p_min[0], b.p_min[0]),
+                      std::max(p_min[1], b.p_min[1]),
+                      std::max(p_min[2], b.p_min[2])),
+                Point(std::min(p_max[0], b.p_max[0]),
+                      std::min(p_max[1], b.p_max[1]),
+                      std::min(p_max[2], b.p_max[2]))};
+    }
+
+    // True for figures without bounds (i.e. infinite planes), and for empty boxes
+    [[nodiscard]] bool is_unbounded() const {
+        for (int a = 0; a < 3; a++) {
+            if (p_min[a] == std::numeric_limits<Real>::lowest() || p_min[a] == std::numeric_limits<Real>::max() ||
+                p_max[a] == std::numeric_limits<Real>::lowest() || p_max[a] == std::numeric_limits<Real>::max())
+                return true;
+        }
+
+        return false;
+    }
+
     // Return's the biggest axis index
     // 0 (x), 1(y) or 2(z)
     [[nodiscard]] int maximum_extent() const {
@@ -84,18 +105,18 @@ public:
 
     // Optimized Bounding Box collision, adapted from:
     //  https://raytracing.github.io/books/RayTracingTheNextWeek.html#boundingvolumehierarchies
-    [[nodiscard]] std::tuple<bool, double, double>  collides(const Ray &ray) const {
+    [[nodiscard]] std::tuple<bool, Real, Real>  collides(const Ray &ray) const {
 #ifdef benchmarking
         Benchmarking::count_bounds_checked();
 #endif
-        double t_min = std::numeric_limits<double>::min();
-        double t_max = std::numeric_limits<double>::max();
+        Real t_min = std::numeric_limits<Real>::min();
+        Real t_max = std::numeric_limits<Real>::max();
 
         for (int a = 0; a < 3; a++) {
-            auto invD = 1.0f / ray.direction[a];
+            auto invD = 1 / ray.direction[a];
             auto t0 = (p_min[a] - ray.origin[a]) * invD;
             auto t1 = (p_max[a] - ray.origin[a]) * invD;
-            if (invD < 0.0f)
+            if (invD < 0)
                 std::swap(t0, t1);
             t_min = t0 > t_min ? t0 : t_min;
             t_max = t1 < t_max ? t1 : t_max;
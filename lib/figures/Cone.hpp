@@ -2,7 +2,7 @@
 // Cone.hpp
 //
 // Description:
-//  Cone figure
+//  Cone figure, along any axis and optionally closed by its base
 //
 // Authors:
 //  Samuel García
@@ -14,15 +14,80 @@
 
 #ifndef INFORMATICA_GRAFICA_CONE_H
 #define INFORMATICA_GRAFICA_CONE_H
+#include <algorithm>
 #include "Figure.hpp"
+#ifdef benchmarking
+#include "benchmarking.hpp"
+#endif
 
 class Cone : public Figure {
 private:
+    // Apex, and axis from it towards the center of the base, of radius r at distance h
     Point c;
-    double h;
+    Direction axis;
+    double r, h;
+    bool capped;
+
+    // 1 + tan^2 of the half angle: points p of the surface satisfy |p - c|^2 = slope * ((p - c) · axis)^2
+    double slope;
+
+    // Every hit of the ray with the sides (and the base, if any), sorted by t. Returns how many there are
+    int surface_hits(const Ray &ray, double hits[3]) const {
+        int n = 0;
+
+        Vector3d o = ray.origin.v - c.v;
+        double d_axis = ray.direction.v.dot(axis.v), o_axis = o.dot(axis.v);
+
+        double a = ray.direction.v.dot(ray.direction.v) - slope * d_axis * d_axis;
+        double b = 2 * (ray.direction.v.dot(o) - slope * d_axis * o_axis);
+        double c = o.dot(o) - slope * o_axis * o_axis;
+
+        double raiz1 = 0.0, raiz2 = 0.0;
+        int roots = 0;
+        if (a != 0) roots = solveQuadratic(a, b, c, raiz1, raiz2) ? 2 : 0;
+        else if (b != 0) { raiz1 = -c / b; roots = 1; } // Ray parallel to the surface
+
+        // Only the half of the double cone in front of the apex
+        for (double t : {raiz1, raiz2}) {
+            if (roots-- <= 0) break;
+            double s = o_axis + t * d_axis;
+            if (greater_or_equal(s, 0) && greater_or_equal(h, s)) hits[n++] = t;
+        }
+
+        if (capped && d_axis != 0) {
+            double t = (h - o_axis) / d_axis;
+            Vector3d p = o + t * ray.direction.v - h * axis.v;
+            if (p.dot(p) <= r * r) hits[n++] = t;
+        }
+
+        std::sort(hits, hits + n);
+        return n;
+    }
+
+    [[nodiscard]] TraversalHit hit_at(double t) const {
+        TraversalHit reg;
+        reg.hits = true;
+        reg.t = t;
+        reg.figure = this;
+        reg.material_id = material_id;
+
+        return reg;
+    }
 
 public:
+    // Open cone of 45 degrees with its apex at _c, going down the z axis, as in the original scenes
     Cone(Point _c, double _h,
+         Vector3d _diffuse_coefficient,
+         Vector3d _refraction_coefficient,
+         Vector3d _reflection_coefficient,
+         double _refraction_index) :
+            Cone(_c, Direction(0, 0, -1), _h, _h, false,
+                 _diffuse_coefficient,
+                 _refraction_coefficient,
+                 _reflection_coefficient,
+                 _refraction_index) {}
+
+    Cone(Point _c, Direction _axis, double _r, double _h, bool _capped,
          Vector3d _diffuse_coefficient,
          Vector3d _refraction_coefficient,
          Vector3d _reflection_coefficient,
@@ -31,55 +96,72 @@ public:
                    _refraction_coefficient,
                    _reflection_coefficient,
                    _refraction_index),
-            c(_c), h(_h)  {
+            c(_c), axis(_axis.v.normalize()), r(_r), h(_h), capped(_capped), slope(1 + (_r * _r) / (_h * _h)) {
     }
 
-    HitRegister collides(const Ray &ray) const override {
-        HitRegister reg;
+    TraversalHit collides(const Ray &ray) const override {
+#ifdef benchmarking
+        Benchmarking::count_figure_checked();
+#endif
 
-        double raiz1 = 0.0, raiz2 = 0.0;
+        double hits[3];
+        int n = surface_hits(ray, hits);
 
-        auto a =  ray.direction.v[0] * ray.direction.v[0] +
-                         ray.direction.v[1] * ray.direction.v[1] -
-                         ray.direction.v[2] * ray.direction.v[2];
+        for (int i = 0; i < n; i++) {
+            if (hits[i] > 0) {
+                TraversalHit reg = hit_at(hits[i]);
+                if (i + 1 < n) reg.t_max = hits[i + 1];
+                return reg;
+            }
+        }
 
-        auto b = 2*(ray.direction.v[0] * ray.origin.v[0] - ray.direction.v[0] * this->c.v[0] +
-                           ray.direction.v[1] * ray.origin.v[1] - ray.direction.v[1] * this->c.v[1] -
-                          (ray.direction.v[2] * ray.origin.v[2] - ray.direction.v[2] * this->c.v[2]));
+        return {};
+    }
 
-        auto c = ray.origin.v[0] * ray.origin.v[0] - 2*ray.origin.v[0] * this->c.v[0] + this->c.v[0] * this->c.v[0] +
-                        ray.origin.v[1] * ray.origin.v[1] - 2*ray.origin.v[1] * this->c.v[1] + this->c.v[1] * this->c.v[1] -
-                       (ray.origin.v[2] * ray.origin.v[2] - 2*ray.origin.v[2] * this->c.v[2] + this->c.v[2] * this->c.v[2]);
+    // A capped cone is convex, so the ray is inside of it between its first and last hits
+    void intervals(const Ray &ray, double t_limit, CSGIntervals &out) const override {
+        if (!capped) return Figure::intervals(ray, t_limit, out);
 
-        auto existeRaiz = solveQuadratic(a, b, c, raiz1, raiz2);
+        double hits[3];
+        int n = surface_hits(ray, hits);
+        if (n > 0) out.add({CSGBoundary(hit_at(hits[0])), CSGBoundary(hit_at(hits[n - 1]))});
+    }
 
-        double t = raiz1;
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        auto p = ray.origin.v + reg.t*ray.direction.v;
 
-        if (less_than(t, 0)) {
-            t = raiz2;
-            if (less_than(t, 0)) return reg;
-        }
+        Vector3d local = p - c.v;
+        double s = local.dot(axis.v);
+        // Gradient of the surface's equation
+        Vector3d gradient = local - slope * s * axis.v;
 
-        // Check the intersection's height
-        auto p = ray.origin.v + t*ray.direction.v;
-        if (p.c[2] > this->c.v[2]  || p.c[2] < this->c.v[2] - h) return reg;
-
-        reg.hits = existeRaiz && (greater_than(raiz1, 0)|| greater_than(raiz2, 0));
-        reg.t = t;
-        reg.n = Ray(Point(p), Direction(2*(p.c[0] - this->c.v[0]), 2*(p.c[1] - this->c.v[1]), 2*(p.c[2] - this->c.v[2])));
-        reg.diffuse_coefficient = diffuse_coefficient;
-        reg.emission = emission;
-        reg.is_area_light = is_area_light;
-        reg.refraction_coefficient = refraction_coefficient;
-        reg.reflection_coefficient = reflection_coefficient;
-        reg.refraction_index = refraction_index;
+        // The hit belongs to the closest surface
+        double side_distance = std::abs((local - s * axis.v).modulus() - s * r / h);
+        if ((capped && std::abs(s - h) < side_distance) || gradient.dot(gradient) == 0) {
+            reg.n = Ray(Point(p), axis);
+        } else {
+            reg.n = Ray(Point(p), Direction(gradient));
+        }
+    }
 
-        return reg;
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(c.v);
+        hasher.add(axis.v);
+        hasher.add(r);
+        hasher.add(h);
+        hasher.add((double) capped);
     }
 
+    // The apex and the base, a disk spanning r * sin(angle between the axis and the coordinate axis)
     Bounds3d bounds() const override {
-        return Bounds3d(Point(c.v[0] - sqrt(h), c.v[1] - sqrt(h),  c.v[2] - h),
-                        Point(c.v[0] + sqrt(h), c.v[1] + sqrt(h),  c.v[2]));
+        Point base(c.v + h * axis.v);
+
+        Vector3d extent;
+        for (int i = 0; i < 3; i++) {
+            extent[i] = r * sqrt(std::max<double>(0.0, 1 - axis[i] * axis[i]));
+        }
+
+        return Bounds3d(Point(base.v - extent), Point(base.v + extent)).Union(c);
     }
 };
 #endif //INFORMATICA_GRAFICA_CONE_H
@@ -28,38 +28,51 @@ public:
     ConstructiveSolidDifference(std::shared_ptr<Figure> _fig1, std::shared_ptr<Figure> _fig2) {
             fig1 = _fig1;
             fig2 = _fig2;
+            box1 = fig1->bounds();
+            box2 = fig2->bounds();
     }
 
-    HitRegister collides(const Ray &ray) const override {
-        HitRegister reg1 = fig1->collides(ray);
-        HitRegister reg2 = fig2->collides(ray);
+    TraversalHit collides(const Ray &ray) const override {
+        CSGIntervals result;
+        intervals(ray, std::numeric_limits<double>::max(), result);
 
-        if (reg1.hits && reg2.hits) {
-            if (reg1.t < reg2.t) return reg1;
-            else if (reg2.t_max < reg1.t_max) {
-                reg2.t = reg2.t_max;
-                return reg2;
-            }
+        return result.first_hit();
+    }
+
+    void intervals(const Ray &ray, double t_limit, CSGIntervals &out) const override {
+        CSGIntervals intervals1, intervals2;
+        bounded_intervals(*fig1, box1, ray, t_limit, intervals1);
+        if (intervals1.empty()) return;
 
-        } else if (reg1.hits) return reg1;
+        // Nothing is left to remove once the ray leaves the first figure
+        bounded_intervals(*fig2, box2, ray, std::min(t_limit, intervals1[intervals1.count - 1].out.t), intervals2);
+        if (intervals2.empty()) {
+            out = intervals1;
+            return;
+        }
 
-        return HitRegister();
+        csg_combine(CSG_DIFFERENCE, intervals1, intervals2, out);
     }
 
-    Bounds3d bounds() const override {
-        Bounds3d box1 = fig1->bounds();
-        Bounds3d box2 = fig2->bounds();
-        float xmin, ymin, zmin, xmax, ymax, zmax;
+    void hash_parameters(SceneHasher &hasher) const override {
+        fig1->hash(hasher);
+        fig2->hash(hasher);
+    }
 
-        xmin = std::min(box1.p_min.v[0], box2.p_min.v[0]);
-        ymin = std::min(box1.p_min.v[1], box2.p_min.v[1]);
-        zmin = std::min(box1.p_min.v[2], box2.p_min.v[2]);
-        xmax = std::max(box1.p_max.v[0], box2.p_max.v[0]);
-        ymax = std::max(box1.p_max.v[1], box2.p_max.v[1]);
-        zmax = std::max(box1.p_max.v[2], box2.p_max.v[2]);
+    // The hits are those of its figures, with their materials
+    void register_materials(MaterialTable &materials) override {
+        fig1->register_materials(materials);
+        fig2->register_materials(materials);
+    }
 
-        return Bounds3d(Point(xmin, ymin, zmin), Point(xmax, ymax, zmax));
+    Bounds3d bounds() const override {
+        // The second figure only removes space from the first one
+        return box1;
     }
+
+private:
+    // Bounds of each figure, to skip them when the ray doesn't reach them
+    Bounds3d box1, box2;
 };
 
 
@@ -0,0 +1,148 @@
+//
+// ConstructiveSolidIntervals.hpp
+//
+// Description:
+//  Spans of a ray inside a solid, used to evaluate constructive solid geometry. Each figure reports the
+//  sorted intervals in which the ray is inside of it, and CSG figures combine the intervals of their
+//  figures with their boolean operation. The hit is the first boundary in front of the ray
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_CONSTRUCTIVESOLIDINTERVALS_HPP
+#define INFORMATICA_GRAFICA_CONSTRUCTIVESOLIDINTERVALS_HPP
+
+#include <limits>
+#include <vector>
+#include "HitRegister.hpp"
+#include "aux.hpp"
+
+// Intervals kept inside CSGIntervals itself. Rays crossing more of them (i.e. through a row of CSG operands) spill
+// the rest to the heap, so none are lost
+#define CSG_MAX_INTERVALS 8
+
+enum CSGOperation {
+    CSG_UNION,
+    CSG_INTERSECTION,
+    CSG_DIFFERENCE
+};
+
+// Surface crossed by the ray at t: only what is needed to compute the surface later on, as in TraversalHit
+class CSGBoundary {
+public:
+    double t{0};
+    const Figure *figure{nullptr};
+    uint32_t material_id{0}, primitive{0};
+    double u{0}, v{0};
+
+    CSGBoundary() = default;
+
+    explicit CSGBoundary(const TraversalHit &reg) : t(reg.t), figure(reg.figure), material_id(reg.material_id),
+                                                  primitive(reg.primitive), u(reg.u), v(reg.v) {}
+
+    [[nodiscard]] TraversalHit hit() const {
+        TraversalHit reg;
+        reg.hits = true;
+        reg.t = t;
+        reg.figure = figure;
+        reg.material_id = material_id;
+        reg.primitive = primitive;
+        reg.u = u;
+        reg.v = v;
+
+        return reg;
+    }
+};
+
+// The ray is inside the figure from in.t to out.t. Surfaces without volume (i.e. planes) have in.t == out.t
+class CSGInterval {
+public:
+    CSGBoundary in, out;
+};
+
+class CSGIntervals {
+private:
+    CSGInterval intervals[CSG_MAX_INTERVALS];
+    std::vector<CSGInterval> overflow;
+
+public:
+    int count = 0;
+
+    // Intervals must be added sorted by t
+    void add(const CSGInterval &interval) {
+        if (count < CSG_MAX_INTERVALS) intervals[count] = interval;
+        else overflow.push_back(interval);
+        count++;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return count == 0;
+    }
+
+    CSGInterval &operator[](int i) {
+        return i < CSG_MAX_INTERVALS ? intervals[i] : overflow[i - CSG_MAX_INTERVALS];
+    }
+
+    const CSGInterval &operator[](int i) const {
+        return i < CSG_MAX_INTERVALS ? intervals[i] : overflow[i - CSG_MAX_INTERVALS];
+    }
+
+    // First boundary in front of the ray's origin. t_max is filled with the end of the interval when the ray
+    // enters the figure there
+    [[nodiscard]] TraversalHit first_hit() const {
+        for (int i = 0; i < count; i++) {
+            const CSGInterval &interval = (*this)[i];
+            if (interval.in.t > 0) {
+                TraversalHit reg = interval.in.hit();
+                reg.t_max = interval.out.t;
+                return reg;
+            }
+            if (interval.out.t > 0) return interval.out.hit();
+        }
+
+        return {};
+    }
+};
+
+
+inline bool csg_inside(CSGOperation operation, bool in_a, bool in_b) {
+    switch (operation) {
+        case CSG_UNION: return in_a || in_b;
+        case CSG_INTERSECTION: return in_a && in_b;
+        case CSG_DIFFERENCE: default: return in_a && !in_b;
+    }
+}
+
+// Merges both sorted interval lists with the boolean operation, sweeping their boundaries in order. Each
+// resulting interval keeps the boundaries (and so the surfaces) where it begins and ends
+inline void csg_combine(CSGOperation operation, const CSGIntervals &a, const CSGIntervals &b, CSGIntervals &out) {
+    int i = 0, j = 0;
+    bool in_a = false, in_b = false, inside = false;
+    CSGBoundary start;
+
+    while (i < a.count || j < b.count) {
+        double t_a = i < a.count ? (in_a ? a[i].out.t : a[i].in.t) : std::numeric_limits<double>::max();
+        double t_b = j < b.count ? (in_b ? b[j].out.t : b[j].in.t) : std::numeric_limits<double>::max();
+
+        const CSGBoundary *boundary;
+        if (t_a <= t_b) {
+            boundary = in_a ? &a[i++].out : &a[i].in;
+            in_a = !in_a;
+        } else {
+            boundary = in_b ? &b[j++].out : &b[j].in;
+            in_b = !in_b;
+        }
+
+        bool now_inside = csg_inside(operation, in_a, in_b);
+        if (now_inside && !inside) start = *boundary;
+        else if (!now_inside && inside) out.add({start, *boundary});
+        inside = now_inside;
+    }
+}
+
+#endif //INFORMATICA_GRAFICA_CONSTRUCTIVESOLIDINTERVALS_HPP
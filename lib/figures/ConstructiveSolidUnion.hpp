@@ -27,40 +27,67 @@ public:
     ConstructiveSolidUnion(std::shared_ptr<Figure> _fig1, std::shared_ptr<Figure> _fig2){
             fig1 = _fig1;
             fig2 = _fig2;
+            box1 = fig1->bounds();
+            box2 = fig2->bounds();
     }
 
-    HitRegister collides(const Ray &ray) const override {
-        HitRegister reg1 = fig1->collides(ray);
-        HitRegister reg2 = fig2->collides(ray);
-
-        if(reg1.hits && reg2.hits){
-            if (reg1.t < reg2.t) return reg1;
-            else return reg2;
-        } else if (reg1.hits) {
-            return reg1;
-        } else if (reg2.hits) {
-            return reg2;
-        } else {
-            return reg1;
+    TraversalHit collides(const Ray &ray) const override {
+        // The figure whose box is reached first is intersected first. The other one only matters up to that hit,
+        // so it is skipped if its box starts further away
+        auto [hits1, t_min1, t_max1] = box1.collides(ray);
+        auto [hits2, t_min2, t_max2] = box2.collides(ray);
+        bool first_is_fig1 = !hits2 || (hits1 && t_min1 <= t_min2);
+
+        const Figure &near = first_is_fig1 ? *fig1 : *fig2, &far = first_is_fig1 ? *fig2 : *fig1;
+        const Bounds3d &near_box = first_is_fig1 ? box1 : box2, &far_box = first_is_fig1 ? box2 : box1;
+
+        CSGIntervals near_intervals, far_intervals, result;
+        bounded_intervals(near, near_box, ray, std::numeric_limits<double>::max(), near_intervals);
+        TraversalHit reg = near_intervals.first_hit();
+        double t_limit = reg.hits ? reg.t : std::numeric_limits<double>::max();
+
+        bounded_intervals(far, far_box, ray, t_limit, far_intervals);
+        csg_combine(CSG_UNION, near_intervals, far_intervals, result);
+        reg = result.first_hit();
+
+        // The ray is still inside the other figure at t_limit, so the rest of it is needed
+        if (t_limit < std::numeric_limits<double>::max() && (!reg.hits || reg.t > t_limit)) {
+            far_intervals = CSGIntervals();
+            result = CSGIntervals();
+            bounded_intervals(far, far_box, ray, std::numeric_limits<double>::max(), far_intervals);
+            csg_combine(CSG_UNION, near_intervals, far_intervals, result);
+            reg = result.first_hit();
         }
 
+        return reg;
+    }
+
+    void intervals(const Ray &ray, double t_limit, CSGIntervals &out) const override {
+        CSGIntervals intervals1, intervals2;
+        bounded_intervals(*fig1, box1, ray, t_limit, intervals1);
+        bounded_intervals(*fig2, box2, ray, t_limit, intervals2);
 
+        csg_combine(CSG_UNION, intervals1, intervals2, out);
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        fig1->hash(hasher);
+        fig2->hash(hasher);
+    }
+
+    // The hits are those of its figures, with their materials
+    void register_materials(MaterialTable &materials) override {
+        fig1->register_materials(materials);
+        fig2->register_materials(materials);
     }
 
     Bounds3d bounds() const override {
-        Bounds3d box1 = fig1->bounds();
-        Bounds3d box2 = fig2->bounds();
-        float xmin, ymin, zmin, xmax, ymax, zmax;
-
-        xmin = std::min(box1.p_min.v[0], box2.p_min.v[0]);
-        ymin = std::min(box1.p_min.v[1], box2.p_min.v[1]);
-        zmin = std::min(box1.p_min.v[2], box2.p_min.v[2]);
-        xmax = std::max(box1.p_max.v[0], box2.p_max.v[0]);
-        ymax = std::max(box1.p_max.v[1], box2.p_max.v[1]);
-        zmax = std::max(box1.p_max.v[2], box2.p_max.v[2]);
-
-        return Bounds3d(Point(xmin, ymin, zmin), Point(xmax, ymax, zmax));
+        return box1.Union(box2);
     }
+
+private:
+    // Bounds of each figure, to skip them when the ray doesn't reach them
+    Bounds3d box1, box2;
 };
 
 
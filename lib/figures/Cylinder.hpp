@@ -1,8 +1,8 @@
 //
-// ConstructiveSolidDifference.hpp
+// Cylinder.hpp
 //
 // Description:
-//  Cylinder figure
+//  Cylinder figure, along any axis and optionally closed by its two caps
 //
 // Authors:
 //  Samuel García
@@ -15,15 +15,74 @@
 #ifndef INFORMATICA_GRAFICA_CYLINDER_HPP
 #define INFORMATICA_GRAFICA_CYLINDER_HPP
 
+#include <algorithm>
 #include "Figure.hpp"
+#ifdef benchmarking
+#include "benchmarking.hpp"
+#endif
 
 class Cylinder : public Figure {
 private:
+    // Center of one of the ends, and axis from it towards the other one (at distance h)
     Point c;
+    Direction axis;
     double r, h;
+    bool capped;
+
+    // Every hit of the ray with the sides (and the caps, if any), sorted by t. Returns how many there are
+    int surface_hits(const Ray &ray, double hits[4]) const {
+        int n = 0;
+
+        Vector3d o = ray.origin.v - c.v;
+        double d_axis = ray.direction.v.dot(axis.v), o_axis = o.dot(axis.v);
+        // Components perpendicular to the axis
+        Vector3d d_perp = ray.direction.v - d_axis * axis.v, o_perp = o - o_axis * axis.v;
+
+        double a = d_perp.dot(d_perp);
+        double raiz1 = 0.0, raiz2 = 0.0;
+        if (a > 0 && solveQuadratic(a, 2 * d_perp.dot(o_perp), o_perp.dot(o_perp) - r * r, raiz1, raiz2)) {
+            for (double t : {raiz1, raiz2}) {
+                double s = o_axis + t * d_axis;
+                if (greater_or_equal(s, 0) && greater_or_equal(h, s)) hits[n++] = t;
+            }
+        }
+
+        if (capped && d_axis != 0) {
+            for (double s : {0.0, h}) {
+                double t = (s - o_axis) / d_axis;
+                Vector3d p = o_perp + t * d_perp;
+                if (p.dot(p) <= r * r) hits[n++] = t;
+            }
+        }
+
+        std::sort(hits, hits + n);
+        return n;
+    }
+
+    [[nodiscard]] TraversalHit hit_at(double t) const {
+        TraversalHit reg;
+        reg.hits = true;
+        reg.t = t;
+        reg.figure = this;
+        reg.material_id = material_id;
+
+        return reg;
+    }
 
 public:
+    // Open cylinder going down the z axis from _c, as in the original scenes
     Cylinder(Point _c, double _r, double _h,
+             Vector3d _diffuse_coefficient,
+             Vector3d _refraction_coefficient,
+             Vector3d _reflection_coefficient,
+             double _refraction_index) :
+                    Cylinder(_c, Direction(0, 0, -1), _r, _h, false,
+                             _diffuse_coefficient,
+                             _refraction_coefficient,
+                             _reflection_coefficient,
+                             _refraction_index) {}
+
+    Cylinder(Point _c, Direction _axis, double _r, double _h, bool _capped,
              Vector3d _diffuse_coefficient,
              Vector3d _refraction_coefficient,
              Vector3d _reflection_coefficient,
@@ -32,52 +91,70 @@ public:
                            _refraction_coefficient,
                            _reflection_coefficient,
                            _refraction_index),
-                    c(_c), r(_r), h(_h) {}
-
-    HitRegister collides(const Ray &ray) const override {
-        HitRegister reg;
-
-        double raiz1 = 0.0, raiz2 = 0.0;
-
-        auto a = ray.direction.v[0] * ray.direction.v[0] + ray.direction.v[1] * ray.direction.v[1];
+                    c(_c), axis(_axis.v.normalize()), r(_r), h(_h), capped(_capped) {}
+
+    TraversalHit collides(const Ray &ray) const override {
+#ifdef benchmarking
+        Benchmarking::count_figure_checked();
+#endif
+
+        double hits[4];
+        int n = surface_hits(ray, hits);
+
+        for (int i = 0; i < n; i++) {
+            if (hits[i] > 0) {
+                TraversalHit reg = hit_at(hits[i]);
+                if (i + 1 < n) reg.t_max = hits[i + 1];
+                return reg;
+            }
+        }
 
-        auto b = 2*(ray.direction.v[0] * ray.origin.v[0] - ray.direction.v[0] * this->c.v[0] +
-                           ray.direction.v[1] * ray.origin.v[1] - ray.direction.v[1] * this->c.v[1]);
+        return {};
+    }
 
-        auto c = ray.origin.v[0] * ray.origin.v[0] - 2*ray.origin.v[0] * this->c.v[0] + this->c.v[0] * this->c.v[0] +
-                        ray.origin.v[1] * ray.origin.v[1] - 2*ray.origin.v[1] * this->c.v[1] + this->c.v[1] * this->c.v[1] - r * r;
+    // A capped cylinder is convex, so the ray is inside of it between its first and last hits
+    void intervals(const Ray &ray, double t_limit, CSGIntervals &out) const override {
+        if (!capped) return Figure::intervals(ray, t_limit, out);
 
+        double hits[4];
+        int n = surface_hits(ray, hits);
+        if (n > 0) out.add({CSGBoundary(hit_at(hits[0])), CSGBoundary(hit_at(hits[n - 1]))});
+    }
 
-        auto existeRaiz = solveQuadratic(a, b, c, raiz1, raiz2);
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        auto p = ray.origin.v + reg.t*ray.direction.v;
 
-        double t = raiz1, t_max = raiz2;
+        Vector3d local = p - c.v;
+        double s = local.dot(axis.v);
+        Vector3d radial = local - s * axis.v;
 
-        if (less_than(t, 0)) {
-            t = raiz2;
-            t_max = std::numeric_limits<double>::min();
-            if (less_than(t, 0)) return reg;
+        // The hit belongs to the closest surface
+        if (capped && std::min(std::abs(s), std::abs(s - h)) < std::abs(radial.modulus() - r)) {
+            reg.n = Ray(Point(p), s < h / 2 ? Direction(-1.0 * axis.v) : axis);
+        } else {
+            reg.n = Ray(Point(p), Direction(radial));
         }
+    }
 
-        auto p = ray.origin.v + t*ray.direction.v;
-
-        if (greater_than(p.c[2],this->c.v[2]) || less_than(p.c[2],this->c.v[2] - h)) return reg;
-
-        reg.hits = existeRaiz && (greater_than(raiz1, 0)|| greater_than(raiz2, 0));
-        reg.t = t;
-        reg.t_max = t_max;
-        reg.n = Ray(Point(p), Direction(2*(p.c[0] - this->c.v[0]), 2*(p.c[1] - this->c.v[1]), 0).v.normalize());
-        reg.diffuse_coefficient = diffuse_coefficient;
-        reg.emission = emission;
-        reg.is_area_light = is_area_light;
-        reg.refraction_coefficient = refraction_coefficient;
-        reg.reflection_coefficient = reflection_coefficient;
-        reg.refraction_index = refraction_index;
-
-        return reg;
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(c.v);
+        hasher.add(axis.v);
+        hasher.add(r);
+        hasher.add(h);
+        hasher.add((double) capped);
     }
 
+    // Each end is a disk spanning r * sin(angle between the axis and the coordinate axis) around its center
     Bounds3d bounds() const override {
-        return Bounds3d(Point(c.v[0] - r, c.v[1] - r, c.v[2] - h), Point(c.v[0] + r, c.v[1] + r, c.v[2] + h));
+        Point end(c.v + h * axis.v);
+
+        Vector3d extent;
+        for (int i = 0; i < 3; i++) {
+            extent[i] = r * sqrt(std::max<double>(0.0, 1 - axis[i] * axis[i]));
+        }
+
+        return {Point(Vector3d(std::min(c[0], end[0]), std::min(c[1], end[1]), std::min(c[2], end[2])) - extent),
+                Point(Vector3d(std::max(c[0], end[0]), std::max(c[1], end[1]), std::max(c[2], end[2])) + extent)};
     }
 };
 #endif //INFORMATICA_GRAFICA_CYLINDER_H
@@ -2,7 +2,7 @@
 // Disk.hpp
 //
 // Description:
-//  Disk figure implemented via ConstructiveSolidIntersection
+//  Disk figure: intersection with its plane, and then with its radius
 //
 // Authors:
 //  Samuel García
@@ -15,12 +15,15 @@
 #ifndef INFORMATICA_GRAFICA_DISK_HPP
 #define INFORMATICA_GRAFICA_DISK_HPP
 #include "Figure.hpp"
-#include "Sphere.hpp"
-#include "ConstructiveSolidIntersection.hpp"
+#ifdef benchmarking
+#include "benchmarking.hpp"
+#endif
 
 class Disk : public Figure {
 private:
-    ConstructiveSolidIntersection figure;
+    Point c;
+    double r;
+    Direction n{0, 0, -1}; // normal, facing the camera of the scenes
 
 public:
     Disk(Point _c, double _r,
@@ -31,35 +34,52 @@ public:
                 Figure(_diffuse_coefficient,
                        _refraction_coefficient,
                        _reflection_coefficient,
-                       _refraction_index) {
-        //
-        Sphere circ(_c, _r,
-             _diffuse_coefficient,
-             _refraction_coefficient,
-             _reflection_coefficient,
-             _refraction_index);
+                       _refraction_index),
+                c(_c), r(_r) {}
 
-        Plane plane(_c[2], Direction(0, 0, -1),
-                    Vector3d(0.6, 0.6, 0.6),
-                    Vector3d(0, 0, 0),
-                    Vector3d(0, 0, 0), 1.0);
+    [[nodiscard]] TraversalHit collides(const Ray &ray) const override {
+        TraversalHit reg;
 
-        figure = ConstructiveSolidIntersection(std::make_shared<Plane>(plane), std::make_shared<Sphere>(circ));
-    }
+#ifdef benchmarking
+        Benchmarking::count_figure_checked();
+#endif
+
+        double cosine = ray.direction.v.dot(n.v);
+        if (equals(cosine, 0)) return reg;
+
+        double t = (c.v - ray.origin.v).dot(n.v) / cosine;
+        if (!(t > 0)) return reg;
+
+        Vector3d p = ray.origin.v + t * ray.direction.v - c.v;
+        if (p.dot(p) > r * r) return reg;
+
+        reg.hits = true;
+        reg.t = t;
+        reg.figure = this;
+        reg.material_id = material_id;
 
-    [[nodiscard]] HitRegister collides(const Ray &ray) const override {
-        HitRegister reg = figure.collides(ray);
-        reg.diffuse_coefficient = diffuse_coefficient;
-        reg.emission = emission;
-        reg.is_area_light = is_area_light;
-        reg.refraction_coefficient = refraction_coefficient;
-        reg.reflection_coefficient = reflection_coefficient;
-        reg.refraction_index = refraction_index;
         return reg;
     }
 
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        reg.n = Ray(Point(ray.origin.v + reg.t * ray.direction.v), n);
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(c.v);
+        hasher.add(r);
+        hasher.add(n.v);
+    }
+
+    // The disk spans r * sin(angle between the normal and the axis) on each axis. It is flat, so the box is
+    // slightly widened in order for the rays to be able to hit it
     [[nodiscard]] Bounds3d bounds() const override {
-        return figure.bounds();
+        Vector3d extent;
+        for (int i = 0; i < 3; i++) {
+            extent[i] = r * sqrt(std::max<double>(0.0, 1 - n[i] * n[i])) + ROUNDING_ERROR;
+        }
+
+        return {Point(c.v - extent), Point(c.v + extent)};
     }
 };
 #endif //INFORMATICA_GRAFICA_DISK_HPP
@@ -1,8 +1,8 @@
 //
-// Disk.hpp
+// Ellipsoid.hpp
 //
 // Description:
-//  Ellipsoid figure implemented via TransformedFigure
+//  Ellipsoid figure, intersected as a unit sphere once the ray is scaled by its semi-axes
 //
 // Authors:
 //  Samuel García
@@ -15,14 +15,19 @@
 #ifndef INFORMATICA_GRAFICA_ELLIPSOID_HPP
 #define INFORMATICA_GRAFICA_ELLIPSOID_HPP
 #include "Figure.hpp"
-#include "TransformedFigure.hpp"
+#ifdef benchmarking
+#include "benchmarking.hpp"
+#endif
 
 class Ellipsoid : public Figure {
 private:
-    TransformedFigure ellipsoid;
+    Vector3d center;
+    Vector3d semi_axes, inverse_semi_axes;
 
 public:
 
+    // _o is the center of the unit sphere which is scaled by the semi-axes, so the ellipsoid is centered at
+    // (a * o_x, b * o_y, c * o_z)
     Ellipsoid(Point _o, double _a, double _b, double _c,
               Vector3d _diffuse_coefficient,
               Vector3d _refraction_coefficient,
@@ -31,29 +36,76 @@ public:
                     Figure(_diffuse_coefficient,
                            _refraction_coefficient,
                            _reflection_coefficient,
-                           _refraction_index) {
+                           _refraction_index),
+                    center(_o.v.element_by_element(Vector3d(_a, _b, _c))),
+                    semi_axes(_a, _b, _c),
+                    inverse_semi_axes(1 / _a, 1 / _b, 1 / _c) {}
 
+    [[nodiscard]] TraversalHit collides(const Ray &ray) const override {
+        TraversalHit reg;
 
-        Sphere circ = Sphere(_o, 1,
-                             _diffuse_coefficient,
-                             _refraction_coefficient,
-                             _reflection_coefficient,
-                             _refraction_index);
+#ifdef benchmarking
+        Benchmarking::count_figure_checked();
+#endif
 
-        TransformationMatrix m = TransformationMatrix::ScaleMatrix(_a,_b,_c);
-        ellipsoid = TransformedFigure(m, std::make_shared<Sphere>(circ),
-                        _diffuse_coefficient,
-                          _refraction_coefficient,
-                          _reflection_coefficient,
-                          _refraction_index);
+        double raiz1 = 0, raiz2 = 0;
+        if (!unit_sphere_roots(ray, raiz1, raiz2)) return reg;
+
+        // Same as Sphere::collides
+        double t = raiz1, t_max = raiz2;
+
+        if (!(t > 0)) {
+            t = raiz2;
+            t_max = std::numeric_limits<double>::min();
+            if (!(t > 0)) return reg; // Also for NaN rays
+        }
+
+        reg.hits = true;
+        reg.t = t;
+        reg.t_max = t_max;
+        reg.figure = this;
+        reg.material_id = material_id;
+
+        return reg;
+    }
+
+    void intervals(const Ray &ray, double /*t_limit*/, CSGIntervals &out) const override {
+        double raiz1 = 0, raiz2 = 0;
+        if (!unit_sphere_roots(ray, raiz1, raiz2)) return;
+
+        CSGInterval interval;
+        interval.in.t = raiz1;
+        interval.out.t = raiz2;
+        interval.in.figure = interval.out.figure = this;
+        interval.in.material_id = interval.out.material_id = material_id;
+        out.add(interval);
     }
 
-    [[nodiscard]] HitRegister collides(const Ray &ray) const override {
-        return ellipsoid.collides(ray);
+    // The gradient of the ellipsoid's equation
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        auto p = ray.origin.v + reg.t * ray.direction.v;
+        Vector3d scaled = (p - center).element_by_element(inverse_semi_axes).element_by_element(inverse_semi_axes);
+
+        reg.n = Ray(Point(p), Direction(scaled));
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(center);
+        hasher.add(semi_axes);
     }
 
     [[nodiscard]] Bounds3d bounds() const override {
-        return ellipsoid.bounds();
+        return {Point(center - semi_axes), Point(center + semi_axes)};
+    }
+
+private:
+    // Roots of the ray, scaled to the space where the ellipsoid is a unit sphere at the origin. t is the same
+    // in both spaces, since the direction isn't normalized
+    bool unit_sphere_roots(const Ray &ray, double &raiz1, double &raiz2) const {
+        Vector3d o = (ray.origin.v - center).element_by_element(inverse_semi_axes);
+        Vector3d d = ray.direction.v.element_by_element(inverse_semi_axes);
+
+        return solveQuadratic(d.dot(d), 2 * d.dot(o), o.dot(o) - 1, raiz1, raiz2);
     }
 };
 #endif //INFORMATICA_GRAFICA_ELLIPSOID_HPP
@@ -16,59 +16,176 @@
 #ifndef INFORMATICA_GRAFICA_FIGURE_HPP
 #define INFORMATICA_GRAFICA_FIGURE_HPP
 
+#include <typeinfo>
 #include <utility>
 
 #include "../Ray.hpp"
 #include "Bounds3d.hpp"
 #include "HitRegister.hpp"
+#include "ConstructiveSolidIntervals.hpp"
+#include "Material.hpp"
+#include "SceneHasher.hpp"
 #include "Texture.hpp"
+#include "../math/TransformationMatrix.hpp"
 
 class Figure {
+private:
+    Material surface_material;
+
 public:
-    Vector3d diffuse_coefficient, refraction_coefficient, reflection_coefficient, emission;
-    double refraction_index{};
-    std::shared_ptr<Texture> texture;
-    bool has_texture = false, is_area_light = false;
+    // Index in the material table of the scene the figure was added to (see register_materials)
+    uint32_t material_id{0};
 
     Figure() = default;
 
     Figure(Vector3d _diffuse_coefficient,
            Vector3d _refraction_coefficient,
            Vector3d _reflection_coefficient,
-           double _refraction_index) :
-                diffuse_coefficient(_diffuse_coefficient),
-                refraction_coefficient(_refraction_coefficient),
-                reflection_coefficient(_reflection_coefficient),
-                refraction_index(_refraction_index),
-                texture(),
-                has_texture(false),
-                is_area_light(false) {}
-
-    explicit Figure(Vector3d _emission) :
-        emission(_emission),
-        texture(),
-        has_texture(false),
-        is_area_light(true) {}
+           double _refraction_index) {
+        surface_material.diffuse_coefficient = _diffuse_coefficient;
+        surface_material.refraction_coefficient = _refraction_coefficient;
+        surface_material.reflection_coefficient = _reflection_coefficient;
+        surface_material.refraction_index = _refraction_index;
+    }
+
+    explicit Figure(Vector3d _emission) {
+        surface_material.emission = _emission;
+        surface_material.is_area_light = true;
+    }
 
     Figure(Vector3d _diffuse_coefficient,
            Vector3d _refraction_coefficient,
            Vector3d _reflection_coefficient,
            double _refraction_index,
-           std::shared_ptr<Texture> _texture) :
-               diffuse_coefficient(_diffuse_coefficient),
-               refraction_coefficient(_refraction_coefficient),
-               reflection_coefficient(_reflection_coefficient),
-               refraction_index(_refraction_index),
-               texture(_texture),
-               has_texture(true),
-               is_area_light(false) {}
+           std::shared_ptr<Texture> _texture) {
+        surface_material.diffuse_coefficient = _diffuse_coefficient;
+        surface_material.refraction_coefficient = _refraction_coefficient;
+        surface_material.reflection_coefficient = _reflection_coefficient;
+        surface_material.refraction_index = _refraction_index;
+        surface_material.texture = std::move(_texture);
+        surface_material.has_texture = true;
+    }
+
+    [[nodiscard]] const Material &material() const {
+        return surface_material;
+    }
+
+    // Adds the material of the figure, and of the figures it's made of, to the table of the scene it's added to,
+    // so its hits carry the id of the material in that table
+    virtual void register_materials(MaterialTable &materials) {
+        material_id = materials.add(surface_material);
+    }
 
-    [[nodiscard]] virtual HitRegister collides(const Ray &ray) const = 0;
+    // Only finds the hit (t, figure and primitive). Most of them are discarded during traversal, so the rest
+    // is computed by surface_interaction, once for the closest one
+    [[nodiscard]] virtual TraversalHit collides(const Ray &ray) const = 0;
+
+    // Fills the surface normal and the texel of a hit found by collides() with the same ray. Figures which only
+    // forward the hits of other figures (i.e. CSG or BVHs) never receive it
+    virtual void surface_interaction(const Ray &/*ray*/, HitRegister &/*reg*/) const {}
+
+    // Fills out with the sorted intervals of the ray inside the figure, for constructive solid geometry. They
+    // only need to be exact up to t_limit: whatever the figure does further along the ray can be left out.
+    // By default, the interval between the two hits reported by collides(), or just the hit for surfaces
+    virtual void intervals(const Ray &ray, double /*t_limit*/, CSGIntervals &out) const {
+        TraversalHit reg = collides(ray);
+        if (!reg.hits) return;
+
+        CSGInterval interval{CSGBoundary(reg), CSGBoundary(reg)};
+        if (reg.t_max > reg.t) interval.out.t = reg.t_max;
+        out.add(interval);
+    }
 
     virtual Bounds3d bounds() const = 0;
+
+    // Bounds of the figure once transformed (see TransformedFigure). By default, the box enclosing the 8
+    // transformed corners of bounds()
+    [[nodiscard]] virtual Bounds3d transformed_bounds(const AffineTransformation &t) const {
+        Bounds3d box = bounds();
+        if (box.is_unbounded()) return box;
+
+        Bounds3d transformed;
+        for (int corner = 0; corner < 8; corner++) {
+            Vector3d p((corner & 1) ? box.p_max[0] : box.p_min[0],
+                       (corner & 2) ? box.p_max[1] : box.p_min[1],
+                       (corner & 4) ? box.p_max[2] : box.p_min[2]);
+            transformed = transformed.Union(Point(t.point(p)));
+        }
+
+        return transformed;
+    }
+
     virtual ~Figure(){}
 
+    // Figures made of many primitives (i.e. triangle meshes) expose each one of them to the accelerators,
+    // which reference them as (figure, primitive) pairs instead of one heap allocated figure per primitive
+    [[nodiscard]] virtual size_t number_of_primitives() const {
+        return 1;
+    }
+
+    [[nodiscard]] virtual TraversalHit primitive_collides(const Ray &ray, size_t /*primitive*/) const {
+        return collides(ray);
+    }
+
+    [[nodiscard]] virtual Bounds3d primitive_bounds(size_t /*primitive*/) const {
+        return bounds();
+    }
+
+    // Triangle primitives can be packed and tested several at a time (see TrianglePacket.hpp). Returns
+    // false if the primitive isn't a triangle
+    virtual bool primitive_triangle(size_t /*primitive*/, Vector3d &/*a*/, Vector3d &/*b*/, Vector3d &/*c*/) const {
+        return false;
+    }
+
+    // Adds everything which changes how the figure scatters light: its kind, its parameters and its material
+    void hash(SceneHasher &hasher) const {
+        hasher.add(typeid(*this).name());
+        material().hash(hasher);
+        hash_parameters(hasher);
+    }
+
+    // Parameters of the figure. By default, the bounds of its primitives (and the vertices of the triangles), which
+    // every figure of the scenes refines with the parameters that leave them unchanged
+    virtual void hash_parameters(SceneHasher &hasher) const {
+        for (size_t i = 0; i < number_of_primitives(); i++) {
+            Bounds3d bounds = primitive_bounds(i);
+            hasher.add(bounds.p_min.v);
+            hasher.add(bounds.p_max.v);
+
+            Vector3d a, b, c;
+            if (primitive_triangle(i, a, b, c)) {
+                hasher.add(a);
+                hasher.add(b);
+                hasher.add(c);
+            }
+        }
+    }
+
+    // Register of a triangle primitive already hit at t, with barycentric coordinates (u, v)
+    [[nodiscard]] TraversalHit triangle_hit(size_t primitive, double t, double u, double v) const {
+        TraversalHit reg;
+        reg.hits = true;
+        reg.t = t;
+        reg.u = u;
+        reg.v = v;
+        reg.primitive = (uint32_t) primitive;
+        reg.figure = this;
+        reg.material_id = material_id;
+
+        return reg;
+    }
+
 protected:
+    // Intervals of a figure of a CSG tree, skipping it if the ray misses its bounding box or only reaches it
+    // after t_limit
+    static void bounded_intervals(const Figure &figure, const Bounds3d &box, const Ray &ray, double t_limit,
+                                  CSGIntervals &out) {
+        auto [hits, t_min, t_max] = box.collides(ray);
+        if (!hits || t_min > t_limit || less_than(t_max, 0)) return;
+
+        figure.intervals(ray, t_limit, out);
+    }
+
     // Only for textured figures
     virtual Vector3d get_texel_at_hit_point(HitRegister &reg) const {
         return reg.diffuse_coefficient;
@@ -18,27 +18,91 @@
 #ifndef INFORMATICA_GRAFICA_HITREGISTER_HPP
 #define INFORMATICA_GRAFICA_HITREGISTER_HPP
 
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include "../Ray.hpp"
 
+// Bound of the rounding error of a hit point, in units of the precision of Real. Covers the error of the
+// intersection routines (i.e. the roots of the quadrics) and of the transformations
+#define HIT_POINT_ERROR_ULPS 256
 
+
+class Figure;
+
+// Hit found by Figure::collides. It is copied and returned at every level of the traversal (BVH nodes, CSG),
+// so it only keeps what is needed to find the closest hit and to compute its surface afterwards (see HitRegister)
+class TraversalHit {
+public:
+    // Smallest t value in the ray's hit equation o + d*t. In the case of multiple collisions,, t_max will be filled
+    double t{std::numeric_limits<double>::min()}, t_max{std::numeric_limits<double>::min()};
+
+    // What was hit. Barycentric coordinates (u, v) are only used by triangles
+    const Figure *figure{nullptr};
+    double u{0}, v{0};
+    uint32_t primitive{0};
+
+    // Material of the figure hit, in the scene's material table (see Material.hpp)
+    uint32_t material_id{0};
+
+    bool hits{false};
+};
+
+// Full interaction at the closest hit, built once traversal is over
 class HitRegister {
 public:
-    bool hits{false}, is_area_light{false};
+    bool hits{false};
 
-    // Smallest t value in the ray's hit equation o + d*t. In the case of multiple collisions,, t_max will be filled
-    double t{std::numeric_limits<double>::min()}, t_max{std::numeric_limits<double>::min()}, refraction_index{0.0};
+    double t{std::numeric_limits<double>::min()};
 
-    // Surface normal
+    // What was hit: enough to compute the surface later on (see Figure::surface_interaction). Barycentric
+    // coordinates (u, v) are only used by triangles
+    const Figure *figure{nullptr};
+    uint32_t primitive{0};
+    double u{0}, v{0};
+
+    // Surface normal, only filled by Figure::surface_interaction
     Ray n{};
 
-    Vector3d diffuse_coefficient{}, refraction_coefficient{}, reflection_coefficient{}, emission{};
+    // Bound of the rounding error of each coordinate of the hit point (n.origin), see bound_error
+    Vector3d p_error{};
+
+    // Material of the figure hit, in the scene's material table (see Material.hpp)
+    uint32_t material_id{0};
+
+    // Texel at the hit point for textured materials. For the rest it is only filled with the material's diffuse
+    // coefficient once the closest hit is known
+    Vector3d diffuse_coefficient{};
 
 
-    HitRegister() : t(std::numeric_limits<double>::min()), t_max(std::numeric_limits<double>::min()) {}
+    HitRegister() : t(std::numeric_limits<double>::min()) {}
+
+    explicit HitRegister(const TraversalHit &hit) : hits(hit.hits), t(hit.t), figure(hit.figure),
+                                                    primitive(hit.primitive), u(hit.u), v(hit.v),
+                                                    material_id(hit.material_id) {}
 
     HitRegister(bool _hits, double _t, Ray _n, Vector3d _diffuse_coefficient) : hits(_hits), t(_t), diffuse_coefficient(_diffuse_coefficient) {
         n = _n;
     }
+
+    // The hit point o + t*d of the ray is off by a few ulps of the magnitudes involved in computing it
+    void bound_error(const Ray &ray) {
+        double ulps = HIT_POINT_ERROR_ULPS * std::numeric_limits<Real>::epsilon();
+        for (int i = 0; i < 3; i++) {
+            p_error[i] = ulps * (std::abs(ray.origin.v[i]) + std::abs(t * ray.direction.v[i]));
+        }
+    }
+
+    // Origin for the rays leaving the hit point along w: the hit point pushed along the normal, to the side of
+    // w, past its rounding error. The ray can't hit again the surface it leaves, so the figures don't need
+    // any margin to discard those hits
+    [[nodiscard]] Point spawn_origin(const Vector3d &w) const {
+        const Vector3d &normal = n.direction.v;
+        double d = std::abs(normal[0]) * p_error[0] + std::abs(normal[1]) * p_error[1] +
+                   std::abs(normal[2]) * p_error[2];
+
+        return Point(n.origin.v + (w.dot(normal) < 0 ? -d : d) * normal);
+    }
 };
 
 #endif //INFORMATICA_GRAFICA_HITREGISTER_HPP
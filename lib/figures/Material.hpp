@@ -0,0 +1,86 @@
+//
+// Material.hpp
+//
+// Description:
+//  Materials of the figures. Each figure keeps its own until it is added to a scene, which registers it in its
+//  material table: hits only keep a compact id into that table, and the material itself is looked up in the scene
+//  once the closest hit is known
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_MATERIAL_HPP
+#define INFORMATICA_GRAFICA_MATERIAL_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "../math/Vector3d.hpp"
+#include "Texture.hpp"
+#include "SceneHasher.hpp"
+
+class Material {
+public:
+    Vector3d diffuse_coefficient, refraction_coefficient, reflection_coefficient, emission;
+    double refraction_index{};
+    std::shared_ptr<Texture> texture;
+    bool has_texture = false, is_area_light = false;
+
+    [[nodiscard]] bool same_as(const Material &m) const {
+        for (int i = 0; i < 3; i++) {
+            if (diffuse_coefficient[i] != m.diffuse_coefficient[i] ||
+                refraction_coefficient[i] != m.refraction_coefficient[i] ||
+                reflection_coefficient[i] != m.reflection_coefficient[i] ||
+                emission[i] != m.emission[i]) return false;
+        }
+
+        return refraction_index == m.refraction_index && texture == m.texture &&
+               has_texture == m.has_texture && is_area_light == m.is_area_light;
+    }
+
+    // By contents, since ids depend on the order the figures were built in
+    void hash(SceneHasher &hasher) const {
+        hasher.add(diffuse_coefficient);
+        hasher.add(refraction_coefficient);
+        hasher.add(reflection_coefficient);
+        hasher.add(emission);
+        hasher.add(refraction_index);
+        hasher.add((double) is_area_light);
+
+        hasher.add((double) (has_texture && texture));
+        if (has_texture && texture) hasher.add(texture->texture_image.img);
+    }
+};
+
+class MaterialTable {
+    std::vector<Material> materials;
+
+public:
+    // Id 0 is a black material, used by figures which only delegate to other figures (i.e. CSG)
+    MaterialTable() : materials(1) {}
+
+    // Figures sharing the same material (i.e. the walls of a Cornell box) get the same id
+    uint32_t add(const Material &material) {
+        for (size_t i = 0; i < materials.size(); i++) {
+            if (materials[i].same_as(material)) return (uint32_t) i;
+        }
+
+        materials.push_back(material);
+        return (uint32_t) (materials.size() - 1);
+    }
+
+    const Material &operator[](uint32_t id) const {
+        return materials[id];
+    }
+
+    [[nodiscard]] size_t size() const {
+        return materials.size();
+    }
+};
+
+#endif //INFORMATICA_GRAFICA_MATERIAL_HPP
@@ -0,0 +1,355 @@
+//
+// MeshSimplification.hpp
+//
+// Description:
+//  Level of detail for triangle meshes. Meshes are simplified after loading them by collapsing their edges
+//  in order of quadric error (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics"),
+//  down to a number of triangles given by hand or by the size of the mesh on screen
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_MESHSIMPLIFICATION_HPP
+#define INFORMATICA_GRAFICA_MESHSIMPLIFICATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <vector>
+#include "TriangleMesh.hpp"
+#include "camera.hpp"
+
+// Triangles kept per pixel covered by the mesh's bounding box on screen
+#define LOD_TRIANGLES_PER_PIXEL 2
+// Meshes are never simplified below this, they may still be seen through reflections or refractions
+#define LOD_MIN_TRIANGLES 1000
+// Weight of the planes which keep the open borders of the mesh in place
+#define LOD_BORDER_WEIGHT 1000
+
+namespace {
+    // Symmetric 4x4 matrix of the sum of squared distances to a set of planes
+    class Quadric {
+    public:
+        double a2{0}, ab{0}, ac{0}, ad{0}, b2{0}, bc{0}, bd{0}, c2{0}, cd{0}, d2{0};
+
+        Quadric() = default;
+
+        // Plane n · p + d = 0, with n unitary
+        Quadric(const Vector3d &n, double d, double weight) :
+            a2(weight * n[0] * n[0]), ab(weight * n[0] * n[1]), ac(weight * n[0] * n[2]), ad(weight * n[0] * d),
+            b2(weight * n[1] * n[1]), bc(weight * n[1] * n[2]), bd(weight * n[1] * d),
+            c2(weight * n[2] * n[2]), cd(weight * n[2] * d),
+            d2(weight * d * d) {}
+
+        Quadric operator +(const Quadric &q) const {
+            Quadric r;
+            r.a2 = a2 + q.a2; r.ab = ab + q.ab; r.ac = ac + q.ac; r.ad = ad + q.ad;
+            r.b2 = b2 + q.b2; r.bc = bc + q.bc; r.bd = bd + q.bd;
+            r.c2 = c2 + q.c2; r.cd = cd + q.cd;
+            r.d2 = d2 + q.d2;
+            return r;
+        }
+
+        [[nodiscard]] double error(const Vector3d &p) const {
+            double x = p[0], y = p[1], z = p[2];
+            return a2*x*x + 2*ab*x*y + 2*ac*x*z + 2*ad*x + b2*y*y + 2*bc*y*z + 2*bd*y + c2*z*z + 2*cd*z + d2;
+        }
+
+        // Point of minimum error, unless the planes are (almost) parallel and it isn't unique
+        bool minimum(Vector3d &p) const {
+            double det = a2 * (b2*c2 - bc*bc) - ab * (ab*c2 - bc*ac) + ac * (ab*bc - b2*ac);
+            double trace = a2 + b2 + c2;
+            if (std::abs(det) <= 1e-6 * trace * trace * trace) return false;
+
+            // Cramer's rule on A p = -(ad, bd, cd)
+            p = Vector3d(-(ad * (b2*c2 - bc*bc) - ab * (bd*c2 - bc*cd) + ac * (bd*bc - b2*cd)) / det,
+                         -(a2 * (bd*c2 - cd*bc) - ad * (ab*c2 - bc*ac) + ac * (ab*cd - bd*ac)) / det,
+                         -(a2 * (b2*cd - bc*bd) - ab * (ab*cd - bd*ac) + ad * (ab*bc - b2*ac)) / det);
+            return true;
+        }
+    };
+
+    // Candidate collapse of the edge (v0, v1). Stamps are the versions of both vertices when it was computed,
+    // so entries left behind by other collapses are skipped
+    struct EdgeCollapse {
+        double cost;
+        uint32_t v0, v1;
+        uint32_t stamp0, stamp1;
+        Vector3d p;
+
+        bool operator >(const EdgeCollapse &e) const {
+            return cost > e.cost;
+        }
+    };
+
+    class MeshSimplifier {
+    public:
+        explicit MeshSimplifier(TriangleMesh &_mesh) : mesh(_mesh),
+            quadrics(_mesh.vertices.size()), vertex_triangles(_mesh.vertices.size()),
+            stamp(_mesh.vertices.size(), 0), vertex_removed(_mesh.vertices.size(), false),
+            triangle_removed(_mesh.triangles.size(), false), live_triangles(_mesh.triangles.size()) {}
+
+        void simplify(size_t target_triangles) {
+            compute_quadrics();
+
+            for (uint32_t t = 0; t < mesh.triangles.size(); t++) {
+                for (uint32_t v : mesh.triangles[t]) vertex_triangles[v].push_back(t);
+            }
+
+            for (uint32_t t = 0; t < mesh.triangles.size(); t++) {
+                const auto &tr = mesh.triangles[t];
+                for (int i = 0; i < 3; i++) {
+                    // Each edge once (shared edges appear in opposite directions in both triangles)
+                    uint32_t a = tr[i], b = tr[(i + 1) % 3];
+                    if (a < b || !shares_edge(b, a)) push_collapse(a, b);
+                }
+            }
+
+            while (live_triangles > target_triangles && !queue.empty()) {
+                EdgeCollapse e = queue.top();
+                queue.pop();
+
+                if (vertex_removed[e.v0] || vertex_removed[e.v1] ||
+                    stamp[e.v0] != e.stamp0 || stamp[e.v1] != e.stamp1) continue;
+
+                collapse(e);
+            }
+
+            compact();
+        }
+
+    private:
+        TriangleMesh &mesh;
+        std::vector<Quadric> quadrics;
+        std::vector<std::vector<uint32_t>> vertex_triangles;
+        std::vector<uint32_t> stamp;
+        std::vector<bool> vertex_removed, triangle_removed;
+        size_t live_triangles;
+        std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>, std::greater<EdgeCollapse>> queue;
+
+        // Whether the directed edge (a, b) belongs to some triangle
+        bool shares_edge(uint32_t a, uint32_t b) const {
+            for (uint32_t t : vertex_triangles[a]) {
+                const auto &tr = mesh.triangles[t];
+                for (int i = 0; i < 3; i++) {
+                    if (tr[i] == a && tr[(i + 1) % 3] == b) return true;
+                }
+            }
+            return false;
+        }
+
+        // Planes of the triangles around each vertex, plus planes perpendicular to the open borders
+        void compute_quadrics() {
+            std::vector<uint64_t> edges;
+            edges.reserve(3 * mesh.triangles.size());
+            for (const auto &tr : mesh.triangles) {
+                for (int i = 0; i < 3; i++) {
+                    uint64_t a = tr[i], b = tr[(i + 1) % 3];
+                    edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+
+            for (const auto &tr : mesh.triangles) {
+                const Vector3d &p0 = mesh.vertices[tr[0]], &p1 = mesh.vertices[tr[1]], &p2 = mesh.vertices[tr[2]];
+                Vector3d normal = (p1 - p0) * (p2 - p0);
+                double area = normal.modulus();
+                if (area == 0) continue;
+                normal = normal / area;
+
+                // Weighted by area, so that tiny triangles don't pull the vertices around
+                Quadric q(normal, -normal.dot(p0), area);
+                for (uint32_t v : tr) quadrics[v] = quadrics[v] + q;
+
+                for (int i = 0; i < 3; i++) {
+                    uint64_t a = tr[i], b = tr[(i + 1) % 3];
+                    uint64_t key = std::min(a, b) << 32 | std::max(a, b);
+                    auto range = std::equal_range(edges.begin(), edges.end(), key);
+                    if (range.second - range.first != 1) continue;
+
+                    const Vector3d &pa = mesh.vertices[a], &pb = mesh.vertices[b];
+                    Vector3d border = (pb - pa) * normal;
+                    double length = border.modulus();
+                    if (length == 0) continue;
+                    border = border / length;
+
+                    Quadric q_border(border, -border.dot(pa), LOD_BORDER_WEIGHT * length * length);
+                    quadrics[a] = quadrics[a] + q_border;
+                    quadrics[b] = quadrics[b] + q_border;
+                }
+            }
+        }
+
+        void push_collapse(uint32_t v0, uint32_t v1) {
+            Quadric q = quadrics[v0] + quadrics[v1];
+
+            const Vector3d &p0 = mesh.vertices[v0], &p1 = mesh.vertices[v1];
+            Vector3d p;
+            if (!q.minimum(p)) {
+                // Best of both ends and the midpoint
+                Vector3d midpoint = (p0 + p1) / 2;
+                p = p0;
+                if (q.error(p1) < q.error(p)) p = p1;
+                if (q.error(midpoint) < q.error(p)) p = midpoint;
+            }
+
+            queue.push({std::max(q.error(p), 0.0), v0, v1, stamp[v0], stamp[v1], p});
+        }
+
+        // Whether moving the vertex v to p flips any of its triangles not removed by the collapse of (v, other)
+        bool flips(uint32_t v, uint32_t other, const Vector3d &p) const {
+            for (uint32_t t : vertex_triangles[v]) {
+                if (triangle_removed[t]) continue;
+
+                const auto &tr = mesh.triangles[t];
+                if (tr[0] == other || tr[1] == other || tr[2] == other) continue;
+
+                Vector3d corners[3], moved[3];
+                for (int i = 0; i < 3; i++) {
+                    corners[i] = mesh.vertices[tr[i]];
+                    moved[i] = tr[i] == v ? p : corners[i];
+                }
+
+                Vector3d before = (corners[1] - corners[0]) * (corners[2] - corners[0]);
+                Vector3d after = (moved[1] - moved[0]) * (moved[2] - moved[0]);
+                if (after.dot(before) <= 0) return true;
+            }
+            return false;
+        }
+
+        // Merges v1 into v0, placed at the edge's point of minimum error
+        void collapse(const EdgeCollapse &e) {
+            if (flips(e.v0, e.v1, e.p) || flips(e.v1, e.v0, e.p)) return;
+
+            std::vector<uint32_t> triangles;
+            for (uint32_t v : {e.v0, e.v1}) {
+                for (uint32_t t : vertex_triangles[v]) {
+                    if (triangle_removed[t]) continue;
+
+                    auto &tr = mesh.triangles[t];
+                    bool has_v0 = tr[0] == e.v0 || tr[1] == e.v0 || tr[2] == e.v0;
+                    bool has_v1 = tr[0] == e.v1 || tr[1] == e.v1 || tr[2] == e.v1;
+                    if (has_v0 && has_v1) {
+                        // Degenerates into the edge
+                        triangle_removed[t] = true;
+                        live_triangles--;
+                        continue;
+                    }
+
+                    for (auto &corner : tr) if (corner == e.v1) corner = e.v0;
+                    triangles.push_back(t);
+                }
+            }
+
+            std::sort(triangles.begin(), triangles.end());
+            triangles.erase(std::unique(triangles.begin(), triangles.end()), triangles.end());
+
+            mesh.vertices[e.v0] = e.p;
+            quadrics[e.v0] = quadrics[e.v0] + quadrics[e.v1];
+            vertex_triangles[e.v0] = std::move(triangles);
+            vertex_triangles[e.v1].clear();
+            vertex_triangles[e.v1].shrink_to_fit();
+            vertex_removed[e.v1] = true;
+            stamp[e.v0]++;
+
+            // Every edge around the vertex changed its cost
+            std::vector<uint32_t> neighbours;
+            for (uint32_t t : vertex_triangles[e.v0]) {
+                for (uint32_t v : mesh.triangles[t]) if (v != e.v0) neighbours.push_back(v);
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+            for (uint32_t v : neighbours) push_collapse(e.v0, v);
+        }
+
+        // Drops the removed triangles and vertices. Texture coordinates and normals are kept per corner
+        void compact() {
+            std::vector<uint32_t> new_index(mesh.vertices.size(), TriangleMesh::NO_INDEX);
+            for (size_t t = 0; t < mesh.triangles.size(); t++) {
+                if (!triangle_removed[t]) for (uint32_t v : mesh.triangles[t]) new_index[v] = 0;
+            }
+
+            std::vector<Vector3d> vertices;
+            for (uint32_t v = 0; v < mesh.vertices.size(); v++) {
+                if (new_index[v] == TriangleMesh::NO_INDEX) continue;
+                new_index[v] = (uint32_t) vertices.size();
+                vertices.push_back(mesh.vertices[v]);
+            }
+
+            size_t kept = 0;
+            for (size_t t = 0; t < mesh.triangles.size(); t++) {
+                if (triangle_removed[t]) continue;
+
+                for (int i = 0; i < 3; i++) mesh.triangles[kept][i] = new_index[mesh.triangles[t][i]];
+                if (!mesh.triangle_uvs.empty()) mesh.triangle_uvs[kept] = mesh.triangle_uvs[t];
+                if (!mesh.triangle_normals.empty()) mesh.triangle_normals[kept] = mesh.triangle_normals[t];
+                kept++;
+            }
+
+            mesh.vertices = std::move(vertices);
+            mesh.triangles.resize(kept);
+            if (!mesh.triangle_uvs.empty()) mesh.triangle_uvs.resize(kept);
+            if (!mesh.triangle_normals.empty()) mesh.triangle_normals.resize(kept);
+        }
+    };
+}
+
+// Simplifies the mesh down to (about) target_triangles. Collapses which would flip a triangle are skipped, so
+// it may stop above the target
+void simplify_mesh(TriangleMesh &mesh, size_t target_triangles) {
+    if (target_triangles >= mesh.triangles.size()) return;
+
+    size_t original_triangles = mesh.triangles.size();
+    MeshSimplifier(mesh).simplify(target_triangles);
+    mesh.finish();
+
+    std::cout << "Simplified mesh from " << original_triangles << " to " << mesh.triangles.size()
+              << " triangles" << std::endl;
+}
+
+// Triangles needed by the mesh seen from the camera, from the pixels covered by its bounding box
+size_t level_of_detail_triangles(const TriangleMesh &mesh, const Camera &camera,
+                                 double triangles_per_pixel = LOD_TRIANGLES_PER_PIXEL) {
+    Bounds3d box = mesh.bounds();
+
+    // Camera rays are O + x L + y U + z F, with x and y in [-1, 1] across the image
+    Vector3d UxF = camera.U.v * camera.F.v, FxL = camera.F.v * camera.L.v, LxU = camera.L.v * camera.U.v;
+    double det = camera.L.v.dot(UxF);
+
+    double x_min = 1, x_max = -1, y_min = 1, y_max = -1;
+    for (int corner = 0; corner < 8; corner++) {
+        Vector3d p((corner & 1) ? box.p_max[0] : box.p_min[0],
+                   (corner & 2) ? box.p_max[1] : box.p_min[1],
+                   (corner & 4) ? box.p_max[2] : box.p_min[2]);
+        Vector3d d = p - camera.O.v;
+
+        double z = d.dot(LxU) / det;
+        // Behind (or around) the camera, its size on screen is unknown
+        if (z <= 0) return mesh.triangles.size();
+
+        double x = d.dot(UxF) / det / z, y = d.dot(FxL) / det / z;
+        x_min = std::min(x_min, x);
+        x_max = std::max(x_max, x);
+        y_min = std::min(y_min, y);
+        y_max = std::max(y_max, y);
+    }
+
+    double width = std::max(0.0, std::min(x_max, 1.0) - std::max(x_min, -1.0)) * camera.width / 2;
+    double height = std::max(0.0, std::min(y_max, 1.0) - std::max(y_min, -1.0)) * camera.height / 2;
+
+    return std::max((size_t) (width * height * triangles_per_pixel), (size_t) LOD_MIN_TRIANGLES);
+}
+
+void simplify_mesh(TriangleMesh &mesh, const Camera &camera, double triangles_per_pixel = LOD_TRIANGLES_PER_PIXEL) {
+    simplify_mesh(mesh, level_of_detail_triangles(mesh, camera, triangles_per_pixel));
+}
+
+#endif //INFORMATICA_GRAFICA_MESHSIMPLIFICATION_HPP
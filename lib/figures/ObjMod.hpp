@@ -1,8 +1,9 @@
 //
-// TriangleMesh.hpp
+// ObjMod.hpp
 //
 // Description:
-//  Simple OBJ file vertex-to-triangles converter
+//  Simple OBJ file loader, which builds an indexed TriangleMesh sharing the file's vertex, texture coordinate
+//  and normal arrays
 //
 //
 // Authors:
@@ -18,145 +19,143 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
-#include <sstream>
-#include <regex>
-#include "Triangle.hpp"
+#include <cstdlib>
+#include <cctype>
+#include <memory>
+#include "TriangleMesh.hpp"
+
+namespace {
+    // OBJ indices start at 1, negative ones are relative to the end of the list read so far
+    inline uint32_t obj_index(long i, size_t elements) {
+        if (i < 0) return (uint32_t) (elements + i);
+        return (uint32_t) (i - 1);
+    }
 
-// Textured
-std::vector<Triangle> load_obj(std::string filename,
-                               Vector3d tr_diffuse_coefficient,
-                               Vector3d tr_refraction_coefficient,
-                               Vector3d tr_reflection_coefficient,
-                               double tr_refraction_index,
-                               std::shared_ptr<Texture> _texture) {
-    std::vector<Vector3d> v;
-    std::vector<Vector3d> vt;
-    std::vector<Vector3d> vn;
-    std::vector<Triangle> f;
-
-    std::ifstream infile(filename);
-    std::string line, s;
-    double x, y, z, vtx, vty, vtz, vnx, vny, vnz;
-
-    std::cout << "Loading textured .obj (it might take a minute...)" << std::endl;
-
-    while (std::getline(infile, line)) {
-        std::istringstream iss(line);
-        iss >> s;
-        if (s == "v") { // Vertex
-            iss >> x >> y >> z;
-            v.emplace_back(x, y, z);
-        } else if (s == "vt") { // Texture
-            iss >> x >> y;
-            vt.emplace_back(x, y, 0);
-        } else if (s == "vn") { // Normal
-            iss >> x >> y >> z;
-            vn.emplace_back(x, y, z);
-        } else if (s == "f") { // Figure
-            std::regex pattern1(R"(f (\d+)/(\d+)/(\d+) (\d+)/(\d+)/(\d+) (\d+)/(\d+)/(\d+))"); // Vertex + Texture + Normal
-            std::regex pattern2(R"(f (\d+)//(\d+) (\d+)//(\d+) (\d+)//(\d+))"); // Vertex + Normal
-            std::regex pattern3(R"(f (\d+)/(\d+) (\d+)/(\d+) (\d+)/(\d+))"); // Vertex + Texture
-            std::regex pattern4(R"(f (\d+) (\d+) (\d+))"); // Vertex
-
-            std::smatch matches;
-            if (std::regex_search(line, matches, pattern1)) { // We ignore vn's
-                x = std::stoi(matches[1]); vtx = std::stoi(matches[2]); vnx = std::stoi(matches[3]);
-                y = std::stoi(matches[4]); vty = std::stoi(matches[5]); vny = std::stoi(matches[6]);
-                z = std::stoi(matches[7]); vtz = std::stoi(matches[8]); vnz = std::stoi(matches[9]);
-                f.emplace_back(Point(v[x - 1]),
-                               Point(v[y - 1]),
-                               Point(v[z - 1]),
-                               tr_diffuse_coefficient,
-                               tr_refraction_coefficient,
-                               tr_reflection_coefficient,
-                               tr_refraction_index, _texture,
-                               Point(vt[vtx - 1]),
-                               Point(vt[vty - 1]),
-                               Point(vt[vtz - 1]));
-
-            } else if (std::regex_search(line, matches, pattern2)) {
-                x = std::stoi(matches[1]); vnx = std::stoi(matches[2]);
-                y = std::stoi(matches[3]); vny = std::stoi(matches[4]);
-                z = std::stoi(matches[5]); vnz = std::stoi(matches[6]);
-                f.emplace_back(Point(v[x - 1]),
-                               Point(v[y - 1]),
-                               Point(v[z - 1]),
-                               tr_diffuse_coefficient,
-                               tr_refraction_coefficient,
-                               tr_reflection_coefficient,
-                               tr_refraction_index);
-
-            } else if (std::regex_search(line, matches, pattern3)) {
-                x = std::stoi(matches[1]); vtx = std::stoi(matches[2]);
-                y = std::stoi(matches[3]); vty = std::stoi(matches[4]);
-                z = std::stoi(matches[5]); vtz = std::stoi(matches[6]);
-                f.emplace_back(Point(v[x - 1]),
-                               Point(v[y - 1]),
-                               Point(v[z - 1]),
-                               tr_diffuse_coefficient,
-                               tr_refraction_coefficient,
-                               tr_reflection_coefficient,
-                               tr_refraction_index, _texture,
-                               Point(vt[vtx - 1]),
-                               Point(vt[vty - 1]),
-                               Point(vt[vtz - 1]));
-
-            } else if (std::regex_search(line, matches, pattern4)) {
-                x = std::stoi(matches[1]);
-                y = std::stoi(matches[2]);
-                z = std::stoi(matches[3]);
-                f.emplace_back(Point(v[x - 1]),
-                               Point(v[y - 1]),
-                               Point(v[z - 1]),
-                               tr_diffuse_coefficient,
-                               tr_refraction_coefficient,
-                               tr_reflection_coefficient,
-                               tr_refraction_index);
+    inline const char *skip_spaces(const char *p) {
+        while (*p != '\0' && std::isspace((unsigned char) *p)) ++p;
+        return p;
+    }
+
+    // Parses "v", "v/vt", "v//vn" or "v/vt/vn", missing indices are returned as 0
+    inline const char *parse_face_vertex(const char *p, long &v, long &vt, long &vn) {
+        char *end;
+        v = std::strtol(p, &end, 10);
+        vt = vn = 0;
+        if (*end == '/') {
+            p = end + 1;
+            if (*p != '/') {
+                vt = std::strtol(p, &end, 10);
+                p = end;
+            }
+            if (*p == '/') {
+                vn = std::strtol(p + 1, &end, 10);
             }
         }
+        return end;
     }
 
-    std::cout  << "Finished loading textured .obj" << std::endl;
-    return f;
+    void read_obj(const std::string &filename, TriangleMesh &mesh, bool with_uvs) {
+        std::ifstream infile(filename);
+        std::string line;
+
+        // Reused between faces, polygons with more than three vertices are triangulated as a fan
+        std::vector<TriangleMesh::Indices> polygon;
+
+        while (std::getline(infile, line)) {
+            const char *p = skip_spaces(line.c_str());
+            char *end;
+
+            if (p[0] == 'v' && std::isspace((unsigned char) p[1])) { // Vertex
+                double x = std::strtod(p + 1, &end);
+                double y = std::strtod(end, &end);
+                double z = std::strtod(end, &end);
+                mesh.vertices.emplace_back(x, y, z);
+            } else if (p[0] == 'v' && p[1] == 't' && with_uvs) { // Texture
+                double x = std::strtod(p + 2, &end);
+                double y = std::strtod(end, &end);
+                mesh.uvs.emplace_back(x, y, 0);
+            } else if (p[0] == 'v' && p[1] == 'n') { // Normal
+                double x = std::strtod(p + 2, &end);
+                double y = std::strtod(end, &end);
+                double z = std::strtod(end, &end);
+                mesh.normals.emplace_back(x, y, z);
+            } else if (p[0] == 'f' && std::isspace((unsigned char) p[1])) { // Face
+                polygon.clear();
+                p = skip_spaces(p + 1);
+                while (*p != '\0') {
+                    long v, vt, vn;
+                    p = skip_spaces(parse_face_vertex(p, v, vt, vn));
+                    if (v == 0) break;
+
+                    polygon.push_back({obj_index(v, mesh.vertices.size()),
+                                       vt != 0 ? obj_index(vt, mesh.uvs.size()) : TriangleMesh::NO_INDEX,
+                                       vn != 0 ? obj_index(vn, mesh.normals.size()) : TriangleMesh::NO_INDEX});
+                }
+
+                for (size_t i = 2; i < polygon.size(); i++) {
+                    const auto &a = polygon[0], &b = polygon[i - 1], &c = polygon[i];
+                    mesh.triangles.push_back({a[0], b[0], c[0]});
+
+                    if (with_uvs) {
+                        if (a[1] != TriangleMesh::NO_INDEX && b[1] != TriangleMesh::NO_INDEX && c[1] != TriangleMesh::NO_INDEX)
+                            mesh.triangle_uvs.push_back({a[1], b[1], c[1]});
+                        else
+                            mesh.triangle_uvs.push_back({TriangleMesh::NO_INDEX, TriangleMesh::NO_INDEX, TriangleMesh::NO_INDEX});
+                    }
+
+                    if (a[2] != TriangleMesh::NO_INDEX && b[2] != TriangleMesh::NO_INDEX && c[2] != TriangleMesh::NO_INDEX)
+                        mesh.triangle_normals.push_back({a[2], b[2], c[2]});
+                    else
+                        mesh.triangle_normals.push_back({TriangleMesh::NO_INDEX, TriangleMesh::NO_INDEX, TriangleMesh::NO_INDEX});
+                }
+            }
+        }
+
+        // Don't keep index arrays which don't reference anything
+        if (mesh.uvs.empty()) mesh.triangle_uvs.clear();
+        if (mesh.normals.empty()) mesh.triangle_normals.clear();
+
+        mesh.finish();
+    }
+}
+
+// Textured
+std::shared_ptr<TriangleMesh> load_obj(const std::string &filename,
+                                       Vector3d tr_diffuse_coefficient,
+                                       Vector3d tr_refraction_coefficient,
+                                       Vector3d tr_reflection_coefficient,
+                                       double tr_refraction_index,
+                                       std::shared_ptr<Texture> _texture) {
+    std::cout << "Loading textured .obj" << std::endl;
+
+    auto mesh = std::make_shared<TriangleMesh>(tr_diffuse_coefficient,
+                                               tr_refraction_coefficient,
+                                               tr_reflection_coefficient,
+                                               tr_refraction_index,
+                                               std::move(_texture));
+    read_obj(filename, *mesh, true);
+
+    std::cout << "Finished loading textured .obj (" << mesh->triangles.size() << " triangles, "
+              << mesh->vertices.size() << " vertices)" << std::endl;
+    return mesh;
 }
 
 // Untextured
-std::vector<Triangle> load_obj(std::string filename,
-                               Vector3d tr_diffuse_coefficient,
-                               Vector3d tr_refraction_coefficient,
-                               Vector3d tr_reflection_coefficient,
-                               double tr_refraction_index) {
+std::shared_ptr<TriangleMesh> load_obj(const std::string &filename,
+                                       Vector3d tr_diffuse_coefficient,
+                                       Vector3d tr_refraction_coefficient,
+                                       Vector3d tr_reflection_coefficient,
+                                       double tr_refraction_index) {
     std::cout << "Loading untextured .obj" << std::endl;
 
-    std::vector<Vector3d> v;
-    std::vector<Vector3d> vt;
-    std::vector<Vector3d> vn;
-    std::vector<Triangle> f;
-
-    std::ifstream infile(filename);
-    std::string line, s, v1, v2, v3;
-    double x, y, z;
-
-    while (std::getline(infile, line)) {
-        std::istringstream iss(line);
-        iss >> s;
-        if (s == "v") { // Vertex
-            iss >> x >> y >> z;
-            v.emplace_back(x, y, z);
-        } else if (s == "f") { // Figure
-            iss >> v1 >> v2 >> v3;
-
-            f.emplace_back(Point(v[stoi(v1.substr(0, s.find('/'))) - 1]),
-                           Point(v[stoi(v2.substr(0, s.find('/'))) - 1]),
-                           Point(v[stoi(v3.substr(0, s.find('/'))) - 1]),
-                           tr_diffuse_coefficient,
-                           tr_refraction_coefficient,
-                           tr_reflection_coefficient,
-                           tr_refraction_index);
-        }
-    }
+    auto mesh = std::make_shared<TriangleMesh>(tr_diffuse_coefficient,
+                                               tr_refraction_coefficient,
+                                               tr_reflection_coefficient,
+                                               tr_refraction_index);
+    read_obj(filename, *mesh, false);
 
-    std::cout << "Finished loading untextured .obj" << std::endl;
-    return f;
+    std::cout << "Finished loading untextured .obj (" << mesh->triangles.size() << " triangles, "
+              << mesh->vertices.size() << " vertices)" << std::endl;
+    return mesh;
 }
 #endif //INFORMATICA_GRAFICA_OBJMOD_HPP
@@ -74,8 +74,8 @@ public:
         bounded = true;
     }
 
-    HitRegister collides(const Ray &ray) const override {
-        HitRegister reg;
+    TraversalHit collides(const Ray &ray) const override {
+        TraversalHit reg;
 
 #ifdef benchmarking
         Benchmarking::count_figure_checked();
@@ -85,31 +85,34 @@ public:
 
         auto p = ray.origin.v + t * ray.direction.v;
 
-        reg.hits = greater_than(t, 0) && (equals((p.dot(n.v) + d) ,0));
+        reg.hits = t > 0 && (equals((p.dot(n.v) + d) ,0));
         reg.t = t;
-        reg.n = Ray(Point(p), Direction(n.v));
+        reg.figure = this;
+        reg.material_id = material_id;
 
-        if (has_texture) {
-            reg.diffuse_coefficient = get_texel_at_hit_point(reg);
-        } else {
-            reg.diffuse_coefficient = diffuse_coefficient;
-        }
+        return reg;
+    }
 
-        reg.emission = emission;
-        reg.is_area_light = is_area_light;
-        reg.refraction_coefficient = refraction_coefficient;
-        reg.reflection_coefficient = reflection_coefficient;
-        reg.refraction_index = refraction_index;
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        reg.n = Ray(Point(ray.origin.v + reg.t * ray.direction.v), Direction(n.v));
 
-        return reg;
+        if (material().has_texture) reg.diffuse_coefficient = get_texel_at_hit_point(reg);
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(d);
+        hasher.add(n.v);
+        hasher.add((double) bounded);
+        hasher.add(min_bound.v);
+        hasher.add(max_bound.v);
     }
 
     Bounds3d bounds() const override {
         if (bounded) {
             return {min_bound, max_bound};
         } else {
-            double min = std::numeric_limits<double>::lowest();
-            double max = std::numeric_limits<double>::max();
+            Real min = std::numeric_limits<Real>::lowest();
+            Real max = std::numeric_limits<Real>::max();
 
             return {Point(min, min, min), Point(max, max, max)};
         }
@@ -125,9 +128,9 @@ private:
         double y = v.dot(reg.n.origin.v);
 
         // (Note: Requires the texture to be seamless
-        if (x < 0) x = texture->texture_image.width + x;
-        if (y < 0) y = texture->texture_image.height + y;
-        return texture->get_texel(x, y);
+        if (x < 0) x = material().texture->texture_image.width + x;
+        if (y < 0) y = material().texture->texture_image.height + y;
+        return material().texture->get_texel(x, y);
     }
 
     // Adapted from:
@@ -0,0 +1,57 @@
+//
+// SceneHasher.hpp
+//
+// Description:
+//  FNV-1a hash of the contents of a scene, which every figure feeds with its kind, its parameters and its material
+//  (see Figure::hash). Used to tell whether something saved for a scene (i.e. a photon map) still belongs to it
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_SCENE_HASHER_HPP
+#define INFORMATICA_GRAFICA_SCENE_HASHER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "../math/Vector3d.hpp"
+
+class SceneHasher {
+    uint64_t hash = 14695981039346656037ull;
+
+public:
+    void add(const void *data, size_t size) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    void add(const char *text) {
+        add(text, std::strlen(text) + 1);
+    }
+
+    void add(double v) {
+        add(&v, sizeof(v));
+    }
+
+    void add(const Vector3d &v) {
+        for (int i = 0; i < 3; i++) add((double) v[i]);
+    }
+
+    void add(const std::vector<Vector3d> &vectors) {
+        add((double) vectors.size());
+        for (const Vector3d &v : vectors) add(v);
+    }
+
+    [[nodiscard]] uint64_t value() const {
+        return hash;
+    }
+};
+
+#endif //INFORMATICA_GRAFICA_SCENE_HASHER_HPP
@@ -57,8 +57,8 @@ public:
 
                 center(_center), r(_r) {}
 
-    HitRegister collides(const Ray &ray) const override {
-        HitRegister reg;
+    TraversalHit collides(const Ray &ray) const override {
+        TraversalHit reg;
 
 #ifdef benchmarking
         Benchmarking::count_figure_checked();
@@ -74,37 +74,54 @@ public:
 
         double t = raiz1, t_max = raiz2;
 
-        if (less_than(t, 0)) {
+        // Rays leaving the sphere start past its surface (see HitRegister::spawn_origin), no margin is needed
+        if (!(t > 0)) {
             t = raiz2;
-            t_max = std::numeric_limits<double>::min();;
-            if (less_than(t, 0)) return reg;
+            t_max = std::numeric_limits<double>::min();
+            if (!(t > 0)) return reg; // Also for NaN rays
         }
 
-        reg.hits = existeRaiz && (greater_than(raiz1, 0) || greater_than(raiz2, 0));
+        reg.hits = existeRaiz;
         reg.t = t;
-        if (greater_or_equal(raiz1, 0)) {
-            reg.t = raiz1;
-        } else {
-            reg.t = raiz2;
-        }
         reg.t_max = t_max;
+        reg.figure = this;
+        reg.material_id = material_id;
 
-        auto p = ray.origin.v + t*ray.direction.v;
-        reg.n = Ray(Point(p), Direction((p - this->center.v)));
+        return reg;
+    }
 
-        if (has_texture) {
-            reg.diffuse_coefficient = get_texel_at_hit_point(reg);
-        } else {
-            reg.diffuse_coefficient = diffuse_coefficient;
-        }
+    // Both roots, even if the ray starts inside the sphere
+    void intervals(const Ray &ray, double /*t_limit*/, CSGIntervals &out) const override {
+#ifdef benchmarking
+        Benchmarking::count_figure_checked();
+#endif
 
-        reg.emission = emission;
-        reg.is_area_light = is_area_light;
-        reg.refraction_coefficient = refraction_coefficient;
-        reg.reflection_coefficient = reflection_coefficient;
-        reg.refraction_index = refraction_index;
+        double raiz1 = 0, raiz2 = 0;
 
-        return reg;
+        double a = ray.direction.v.modulus()*ray.direction.v.modulus();
+        double b = 2*ray.direction.v.dot(ray.origin.v - center.v);
+        double c = (ray.origin.v - center.v).modulus()*(ray.origin.v - center.v).modulus() - r*r;
+
+        if (!solveQuadratic(a, b, c, raiz1, raiz2)) return;
+
+        CSGInterval interval;
+        interval.in.t = raiz1;
+        interval.out.t = raiz2;
+        interval.in.figure = interval.out.figure = this;
+        interval.in.material_id = interval.out.material_id = material_id;
+        out.add(interval);
+    }
+
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        auto p = ray.origin.v + reg.t*ray.direction.v;
+        reg.n = Ray(Point(p), Direction((p - this->center.v)));
+
+        if (material().has_texture) reg.diffuse_coefficient = get_texel_at_hit_point(reg);
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(center.v);
+        hasher.add(r);
     }
 
     Bounds3d bounds() const override {
@@ -114,6 +131,17 @@ public:
         return {min, max};
     }
 
+    // A transformed sphere is an ellipsoid, whose extent on each axis is r times the norm of that row of the matrix
+    Bounds3d transformed_bounds(const AffineTransformation &t) const override {
+        Vector3d c = t.point(center.v);
+        Vector3d extent;
+        for (int i = 0; i < 3; i++) {
+            extent[i] = r * sqrt(t(i, 0)*t(i, 0) + t(i, 1)*t(i, 1) + t(i, 2)*t(i, 2));
+        }
+
+        return {Point(c - extent), Point(c + extent)};
+    }
+
 private:
 
     Vector3d get_texel_at_hit_point(HitRegister &reg) const override {
@@ -126,7 +154,7 @@ private:
         u = 1 - std::abs(u);
         v = 1 - std::abs(v);
 
-        return texture->get_texel(u, v);
+        return material().texture->get_texel(u, v);
     }
 };
 
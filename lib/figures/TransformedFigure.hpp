@@ -22,7 +22,6 @@
 class TransformedFigure : public Figure {
 
 public:
-    TransformationMatrix m;
     std::shared_ptr<Figure> fig;
 
     TransformedFigure(){};
@@ -36,35 +35,71 @@ public:
                                 _refraction_coefficient,
                                 _reflection_coefficient,
                                 _refraction_index),
-                            m(_m), fig(_fig){}
+                            fig(_fig),
+                            to_world(_m),
+                            to_local(_m.inverse()),
+                            normal_to_world(_m.inverse().transpose()) {}
 
 
-    HitRegister collides(const Ray &ray) const override {
-        Ray rtransformado = Ray(Point(m.inverse()*ray.origin.v) , Direction(m.inverse()*ray.direction.v));
-        HitRegister reg = fig->collides(rtransformado);
+    TraversalHit collides(const Ray &ray) const override {
+        TraversalHit reg = fig->collides(local_ray(ray));
 
-        if (reg.hits){
-            reg.n.origin = Point(m*reg.n.origin.v);
-            reg.n.direction = Direction(m.inverse().transpose()*reg.n.direction.v);
-        }
+        // The surface is computed in the figure's space, see below
+        if (reg.hits) reg.figure = this;
 
         return reg;
     }
 
+    void intervals(const Ray &ray, double t_limit, CSGIntervals &out) const override {
+        fig->intervals(local_ray(ray), t_limit, out);
+
+        for (int i = 0; i < out.count; i++) {
+            out[i].in.figure = out[i].out.figure = this;
+        }
+    }
+
+    // Only runs for the closest hit, so it's cheaper to intersect the figure again than to keep which of its
+    // figures was hit for every candidate
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        Ray local = local_ray(ray);
+        HitRegister local_reg(fig->collides(local));
+        if (!local_reg.hits) return;
+
+        // Inside a CSG tree the hit may be where the ray leaves the figure
+        local_reg.t = reg.t;
+
+        local_reg.figure->surface_interaction(local, local_reg);
+
+        reg.n.origin = Point(to_world.point(local_reg.n.origin.v));
+        reg.n.direction = Direction(normal_to_world.direction(local_reg.n.direction.v).normalize());
+        reg.diffuse_coefficient = local_reg.diffuse_coefficient;
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(&to_world, sizeof(to_world));
+        fig->hash(hasher);
+    }
+
+    // The hits are those of the transformed figure, with its material
+    void register_materials(MaterialTable &materials) override {
+        fig->register_materials(materials);
+    }
+
     Bounds3d bounds() const override {
-        Bounds3d box = fig->bounds();
-        Point pmin = Point(m*box.p_min.v);
-        Point pmax = Point(m*box.p_max.v);
-        double xmin, ymin, zmin, xmax, ymax, zmax;
-
-        xmin = std::min(std::min(std::min(pmin.v[0],pmax.v[0]),box.p_min.v[0]),box.p_max.v[0]);
-        ymin = std::min(std::min(std::min(pmin.v[1],pmax.v[1]),box.p_min.v[1]),box.p_max.v[1]);
-        zmin = std::min(std::min(std::min(pmin.v[2],pmax.v[2]),box.p_min.v[2]),box.p_max.v[2]);
-        xmax = std::max(std::max(std::max(pmin.v[0],pmax.v[0]),box.p_min.v[0]),box.p_max.v[0]);
-        ymax = std::max(std::max(std::max(pmin.v[1],pmax.v[1]),box.p_min.v[1]),box.p_max.v[1]);
-        zmax = std::max(std::max(std::max(pmin.v[2],pmax.v[2]),box.p_min.v[2]),box.p_max.v[2]);
-
-        return Bounds3d(Point(xmin,ymin,zmin), Point(xmax,ymax,zmax));
+        return fig->transformed_bounds(to_world);
+    }
+
+private:
+    // Computed once from m, instead of inverting it for every ray
+    AffineTransformation to_world, to_local, normal_to_world;
+
+    // The direction isn't normalized, so t is the same in the figure's space and in world space
+    Ray local_ray(const Ray &ray) const {
+        Ray local;
+        local.origin = Point(to_local.point(ray.origin.v));
+        local.direction = Direction(to_local.direction(ray.direction.v));
+
+        return local;
     }
 };
 
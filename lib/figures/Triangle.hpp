@@ -18,6 +18,7 @@
 #include <algorithm>
 #include "Figure.hpp"
 #include "Plane.hpp"
+#include "TriangleIntersection.hpp"
 #include "benchmarking.hpp"
 #include "../math/TransformationMatrix.hpp"
 
@@ -35,7 +36,7 @@ public:
              Figure(_diffuse_coefficient,
                     _refraction_coefficient,
                     _reflection_coefficient,
-                    _refraction_index), a(_a), b(_b), c(_c) {}
+                    _refraction_index), a(_a), b(_b), c(_c), precomputed(_a.v, _b.v, _c.v) {}
 
     Triangle(Point _a, Point _b, Point _c,
              Vector3d _diffuse_coefficient,
@@ -50,62 +51,42 @@ public:
                    _refraction_index,
                     std::move(_texture)),
              a(_a), b(_b), c(_c),
-             vta(_vta), vtb(_vtb), vtc(_vtc) {}
+             vta(_vta), vtb(_vtb), vtc(_vtc),
+             precomputed(_a.v, _b.v, _c.v) {}
 
 
 
-    // Adapted from Möller–Trumbore's algorithm:
-    //  https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
-    HitRegister collides(const Ray &ray) const override {
-        HitRegister reg;
-
+    // The kernel is chosen by triangle_intersection_method (see TriangleIntersection.hpp)
+    TraversalHit collides(const Ray &ray) const override {
 #ifdef benchmarking
         Benchmarking::count_figure_checked();
 #endif
-        const double EPSILON = 0.0000001;
-        Vector3d vertex0 = this->a.v;
-        Vector3d vertex1 = this->b.v;
-        Vector3d vertex2 = this->c.v;
-        Vector3d edge1, edge2, h, s, q;
-        double a, f, u, v;
-
-        edge1 = vertex1 - vertex0;
-        edge2 = vertex2 - vertex0;
-        h = ray.direction.v * edge2;
-        a = edge1.dot(h);
-        if (a > -EPSILON && a < EPSILON) return reg; // r is parallel to the triangle
-
-        f = 1.0/a;
-        s = ray.origin.v - vertex0;
-        u = f * s.dot(h);
-        if (u < 0.0 || u > 1.0) return reg;
-
-        q = s * edge1;
-        v = f * ray.direction.v.dot(q);
-        if (v < 0.0 || u + v > 1.0) return reg;
-
-        double t = f * edge2.dot(q);
-        if (t > EPSILON) { // Hit!
-            reg.hits = true;
-            reg.t = t;
-            Direction normal = Direction((edge2 * edge1).normalize());
-            reg.n = (less_than(ray.direction.v.dot(edge2 * edge1),0))?
-                        Ray(Point(ray.origin.v + t*ray.direction.v), normal.v) :
-                        Ray(Point(ray.origin.v + t*ray.direction.v), (-1)*normal.v);
-
-            if (has_texture) {
-                reg.diffuse_coefficient = get_texel_at_hit_point(reg);
-            } else {
-                reg.diffuse_coefficient = diffuse_coefficient;
-            }
-            reg.emission = emission;
-            reg.is_area_light = is_area_light;
-            reg.refraction_coefficient = refraction_coefficient;
-            reg.reflection_coefficient = reflection_coefficient;
-            reg.refraction_index = refraction_index;
-
-            return reg;
-        } else return reg;
+        double t, u, v;
+        bool hits = (triangle_intersection_method == WATERTIGHT) ?
+                        watertight(a.v, b.v, c.v, ray, t, u, v) :
+                        moller_trumbore(precomputed, ray, t, u, v);
+        if (!hits) return {};
+
+        return triangle_hit(0, t, u, v);
+    }
+
+    bool primitive_triangle(size_t /*primitive*/, Vector3d &_a, Vector3d &_b, Vector3d &_c) const override {
+        _a = a.v;
+        _b = b.v;
+        _c = c.v;
+        return true;
+    }
+
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        reg.n.origin = Point(ray.origin.v + reg.t*ray.direction.v);
+        reg.n.direction = less_than(ray.direction.v.dot(precomputed.normal), 0) ?
+                            precomputed.normal : (-1)*precomputed.normal;
+
+        if (material().has_texture) reg.diffuse_coefficient = get_texel_at_hit_point(reg);
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        for (const Point &p : {a, b, c, vta, vtb, vtc}) hasher.add(p.v);
     }
 
     Bounds3d bounds() const override {
@@ -121,6 +102,8 @@ public:
         return Bounds3d(Point(xmin,ymin,zmin), Point(xmax,ymax,zmax));
     }
 private:
+    PrecomputedTriangle precomputed;
+
     Vector3d get_texel_at_hit_point(HitRegister &reg) const override {
         Vector3d p = reg.n.origin.v;
 
@@ -138,7 +121,7 @@ private:
         Vector3d P = bary_a * vta.v + bary_b * vtb.v + bary_c * vtc.v;
 
 
-       return texture->get_texel(P[0],  1-P[1]);
+       return material().texture->get_texel(P[0],  1-P[1]);
     }
 };
 #endif //INFORMATICA_GRAFICA_TRIANGLE_HPP
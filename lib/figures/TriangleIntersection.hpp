@@ -0,0 +1,132 @@
+//
+// TriangleIntersection.hpp
+//
+// Description:
+//  Ray-triangle intersection kernels shared by Triangle and TriangleMesh:
+//   - Möller–Trumbore, over edges and normals precomputed when the triangle is built
+//   - Watertight (Woop, Benthin and Wald, 2013), which never lets a ray through the edge shared by two
+//     adjacent triangles
+//
+//  Both return the hit's t and its (u, v) barycentric coordinates, relative to the second and third vertices
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_TRIANGLEINTERSECTION_HPP
+#define INFORMATICA_GRAFICA_TRIANGLEINTERSECTION_HPP
+
+#include <cmath>
+#include "../Ray.hpp"
+
+enum TriangleIntersectionMethod {
+    MOLLER_TRUMBORE,
+    WATERTIGHT
+};
+
+// Kernel used by all triangles, it can be changed before rendering in order to compare both
+inline TriangleIntersectionMethod triangle_intersection_method = WATERTIGHT;
+
+// Minimum t accepted for a hit. Rays leaving a surface already start past its rounding error (see
+// HitRegister::spawn_origin), so there is no need for any margin
+#define TRIANGLE_MIN_T 0
+
+// Triangle data which doesn't depend on the ray
+class PrecomputedTriangle {
+public:
+    Vector3d vertex0, edge1, edge2;
+
+    // Unit geometric normal (edge2 x edge1)
+    Vector3d normal;
+
+    // Rays closer than this to the triangle's plane are considered parallel. It is relative to the
+    // triangle's size, so tiny triangles from scanned meshes aren't discarded
+    double parallel_tolerance{};
+
+    PrecomputedTriangle() = default;
+
+    PrecomputedTriangle(const Vector3d &a, const Vector3d &b, const Vector3d &c) :
+            vertex0(a), edge1(b - a), edge2(c - a) {
+        Vector3d n = edge2 * edge1;
+        double area = n.modulus();
+
+        normal = area > 0 ? n / area : n;
+        parallel_tolerance = 0.0000001 * area;
+    }
+};
+
+// Adapted from Möller–Trumbore's algorithm:
+//  https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
+inline bool moller_trumbore(const PrecomputedTriangle &tr, const Ray &ray, double &t, double &u, double &v) {
+    Vector3d h = ray.direction.v * tr.edge2;
+    double a = tr.edge1.dot(h);
+    if (a > -tr.parallel_tolerance && a < tr.parallel_tolerance) return false; // r is parallel to the triangle
+
+    double f = 1.0/a;
+    Vector3d s = ray.origin.v - tr.vertex0;
+    u = f * s.dot(h);
+    if (u < 0.0 || u > 1.0) return false;
+
+    Vector3d q = s * tr.edge1;
+    v = f * ray.direction.v.dot(q);
+    if (v < 0.0 || u + v > 1.0) return false;
+
+    t = f * tr.edge2.dot(q);
+    return t > TRIANGLE_MIN_T;
+}
+
+// Adapted from "Watertight Ray/Triangle Intersection" (Woop, Benthin and Wald, 2013):
+//  https://jcgt.org/published/0002/01/05/
+// The vertices must be the ones shared with the adjacent triangles (not rebuilt from the edges), so that
+// every triangle sharing an edge computes exactly the same edge function for it
+inline bool watertight(const Vector3d &a, const Vector3d &b, const Vector3d &c, const Ray &ray,
+                       double &t, double &u, double &v) {
+    const Vector3d &dir = ray.direction.v;
+
+    // Dimension where the ray direction is maximal, the other two are swapped to preserve the winding
+    int kz = 0;
+    if (std::abs(dir[1]) > std::abs(dir[kz])) kz = 1;
+    if (std::abs(dir[2]) > std::abs(dir[kz])) kz = 2;
+    int kx = (kz + 1) % 3;
+    int ky = (kx + 1) % 3;
+    if (dir[kz] < 0) std::swap(kx, ky);
+
+    // Shear and scale so the ray goes along +z
+    double Sx = dir[kx] / dir[kz];
+    double Sy = dir[ky] / dir[kz];
+    double Sz = 1.0 / dir[kz];
+
+    Vector3d A = a - ray.origin.v;
+    Vector3d B = b - ray.origin.v;
+    Vector3d C = c - ray.origin.v;
+
+    double Ax = A[kx] - Sx * A[kz], Ay = A[ky] - Sy * A[kz];
+    double Bx = B[kx] - Sx * B[kz], By = B[ky] - Sy * B[kz];
+    double Cx = C[kx] - Sx * C[kz], Cy = C[ky] - Sy * C[kz];
+
+    // Scaled barycentric coordinates (edge functions)
+    double U = Cx * By - Cy * Bx;
+    double V = Ax * Cy - Ay * Cx;
+    double W = Bx * Ay - By * Ax;
+
+    if ((U < 0 || V < 0 || W < 0) && (U > 0 || V > 0 || W > 0)) return false;
+
+    double det = U + V + W;
+    if (det == 0) return false;
+
+    double T = U * Sz * A[kz] + V * Sz * B[kz] + W * Sz * C[kz];
+
+    double inv_det = 1.0 / det;
+    t = T * inv_det;
+    if (t <= TRIANGLE_MIN_T) return false;
+
+    u = V * inv_det;
+    v = W * inv_det;
+    return true;
+}
+
+#endif //INFORMATICA_GRAFICA_TRIANGLEINTERSECTION_HPP
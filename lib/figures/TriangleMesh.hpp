@@ -0,0 +1,196 @@
+//
+// TriangleMesh.hpp
+//
+// Description:
+//  Indexed triangle mesh. Vertices, texture coordinates and normals are stored once and shared between
+//  triangles, which are just triples of 32-bit indices. All of them share the same material.
+//
+//  Accelerators see each triangle as a separate primitive (see Figure::number_of_primitives)
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_TRIANGLEMESH_HPP
+#define INFORMATICA_GRAFICA_TRIANGLEMESH_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "Figure.hpp"
+#include "TriangleIntersection.hpp"
+#include "TrianglePacket.hpp"
+#include "benchmarking.hpp"
+
+class TriangleMesh : public Figure {
+public:
+    using Indices = std::array<uint32_t, 3>;
+
+    // Marks a triangle without texture coordinates inside a textured mesh
+    static constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+    std::vector<Vector3d> vertices, uvs, normals;
+    std::vector<Indices> triangles, triangle_uvs, triangle_normals;
+
+    // Edges and normals computed once per triangle, see finish()
+    std::vector<PrecomputedTriangle> precomputed;
+
+    // Consecutive triangles packed TRIANGLE_PACKET_WIDTH at a time, used when there is no acceleration structure
+    std::vector<TrianglePacket> packets;
+
+    TriangleMesh(Vector3d _diffuse_coefficient,
+                 Vector3d _refraction_coefficient,
+                 Vector3d _reflection_coefficient,
+                 double _refraction_index) :
+                    Figure(_diffuse_coefficient,
+                           _refraction_coefficient,
+                           _reflection_coefficient,
+                           _refraction_index) {}
+
+    TriangleMesh(Vector3d _diffuse_coefficient,
+                 Vector3d _refraction_coefficient,
+                 Vector3d _reflection_coefficient,
+                 double _refraction_index,
+                 std::shared_ptr<Texture> _texture) :
+                    Figure(_diffuse_coefficient,
+                           _refraction_coefficient,
+                           _reflection_coefficient,
+                           _refraction_index,
+                           std::move(_texture)) {}
+
+    // Must be called once all the triangles have been added
+    void finish() {
+        box = Bounds3d();
+        for (const auto &v : vertices) box = box.Union(Point(v));
+
+        precomputed.clear();
+        precomputed.reserve(triangles.size());
+        for (const auto &tr : triangles) precomputed.emplace_back(vertices[tr[0]], vertices[tr[1]], vertices[tr[2]]);
+
+        packets.clear();
+        packets.reserve((triangles.size() + TRIANGLE_PACKET_WIDTH - 1) / TRIANGLE_PACKET_WIDTH);
+        for (size_t i = 0; i < triangles.size(); i++) {
+            if (packets.empty() || packets.back().full()) packets.emplace_back();
+
+            const Indices &tr = triangles[i];
+            packets.back().add(vertices[tr[0]], vertices[tr[1]], vertices[tr[2]], (uint32_t) i);
+        }
+
+        vertices.shrink_to_fit();
+        uvs.shrink_to_fit();
+        normals.shrink_to_fit();
+        triangles.shrink_to_fit();
+        triangle_uvs.shrink_to_fit();
+        triangle_normals.shrink_to_fit();
+    }
+
+    [[nodiscard]] size_t number_of_primitives() const override {
+        return triangles.size();
+    }
+
+    // Only used without acceleration structures, every triangle is tested
+    TraversalHit collides(const Ray &ray) const override {
+        if (!std::get<0>(box.collides(ray))) return {};
+
+        const TrianglePacket *closest = nullptr;
+        int closest_lane = -1;
+        double closest_t = 0, closest_u = 0, closest_v = 0;
+        for (const auto &packet : packets) {
+            double t, u, v;
+            int lane = triangle_packet_collides(packet, ray, t, u, v);
+
+            if (lane >= 0 && (closest == nullptr || t < closest_t)) {
+                closest = &packet;
+                closest_lane = lane;
+                closest_t = t;
+                closest_u = u;
+                closest_v = v;
+            }
+        }
+
+        if (closest == nullptr) return {};
+        return triangle_hit(closest->primitive[closest_lane], closest_t, closest_u, closest_v);
+    }
+
+    TraversalHit primitive_collides(const Ray &ray, size_t primitive) const override {
+#ifdef benchmarking
+        Benchmarking::count_figure_checked();
+#endif
+        double t, u, v;
+        bool hits;
+        if (triangle_intersection_method == WATERTIGHT) {
+            const Indices &tr = triangles[primitive];
+            hits = watertight(vertices[tr[0]], vertices[tr[1]], vertices[tr[2]], ray, t, u, v);
+        } else {
+            hits = moller_trumbore(precomputed[primitive], ray, t, u, v);
+        }
+
+        if (!hits) return {};
+        return triangle_hit(primitive, t, u, v);
+    }
+
+    bool primitive_triangle(size_t primitive, Vector3d &a, Vector3d &b, Vector3d &c) const override {
+        const Indices &tr = triangles[primitive];
+        a = vertices[tr[0]];
+        b = vertices[tr[1]];
+        c = vertices[tr[2]];
+        return true;
+    }
+
+    void surface_interaction(const Ray &ray, HitRegister &reg) const override {
+        const PrecomputedTriangle &pre = precomputed[reg.primitive];
+
+        // The normal is already unitary, no need to normalize it again
+        reg.n.origin = Point(ray.origin.v + reg.t*ray.direction.v);
+        reg.n.direction = less_than(ray.direction.v.dot(pre.normal), 0) ? pre.normal : (-1) * pre.normal;
+
+        if (material().has_texture) {
+            bool has_uvs = !triangle_uvs.empty() && triangle_uvs[reg.primitive][0] != NO_INDEX;
+            reg.diffuse_coefficient = has_uvs ? get_texel_at_hit_point(reg.primitive, reg.u, reg.v) :
+                                                material().diffuse_coefficient;
+        }
+    }
+
+    void hash_parameters(SceneHasher &hasher) const override {
+        hasher.add(vertices);
+        hasher.add(uvs);
+        hasher.add(normals);
+        for (const auto *indices : {&triangles, &triangle_uvs, &triangle_normals}) {
+            hasher.add((double) indices->size());
+            hasher.add(indices->data(), indices->size() * sizeof(Indices));
+        }
+    }
+
+    Bounds3d bounds() const override {
+        return box;
+    }
+
+    Bounds3d primitive_bounds(size_t primitive) const override {
+        const Indices &tr = triangles[primitive];
+        const Vector3d &a = vertices[tr[0]], &b = vertices[tr[1]], &c = vertices[tr[2]];
+
+        return {Point(std::min(std::min(a[0], b[0]), c[0]),
+                      std::min(std::min(a[1], b[1]), c[1]),
+                      std::min(std::min(a[2], b[2]), c[2])),
+                Point(std::max(std::max(a[0], b[0]), c[0]),
+                      std::max(std::max(a[1], b[1]), c[1]),
+                      std::max(std::max(a[2], b[2]), c[2]))};
+    }
+
+private:
+    Bounds3d box;
+
+    // (u, v) are the barycentric coordinates of the hit point relative to the second and third vertices
+    Vector3d get_texel_at_hit_point(size_t primitive, double u, double v) const {
+        const Indices &tr = triangle_uvs[primitive];
+        Vector3d P = (1 - u - v) * uvs[tr[0]] + u * uvs[tr[1]] + v * uvs[tr[2]];
+
+        return material().texture->get_texel(P[0], 1-P[1]);
+    }
+};
+
+#endif //INFORMATICA_GRAFICA_TRIANGLEMESH_HPP
@@ -0,0 +1,260 @@
+//
+// TrianglePacket.hpp
+//
+// Description:
+//  Tests one ray against TRIANGLE_PACKET_WIDTH triangles at once. Triangles are packed in SoA layout
+//  (one array per vertex coordinate) so each step of the intersection kernels works on all of them.
+//
+//  Uses AVX when available, falling back to pairs of SSE2 registers and, on other architectures,
+//  to plain loops the compiler can still vectorize
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_TRIANGLEPACKET_HPP
+#define INFORMATICA_GRAFICA_TRIANGLEPACKET_HPP
+
+#include <cstdint>
+#include "TriangleIntersection.hpp"
+#include "benchmarking.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Doubles per packet (one AVX register)
+#define TRIANGLE_PACKET_WIDTH 4
+
+namespace simd {
+#if defined(__AVX__)
+    struct doubles { __m256d v; };
+    struct bools { __m256d v; };
+
+    inline doubles load(const double *p) { return {_mm256_load_pd(p)}; }
+    inline doubles set(double x) { return {_mm256_set1_pd(x)}; }
+
+    inline doubles operator+(doubles a, doubles b) { return {_mm256_add_pd(a.v, b.v)}; }
+    inline doubles operator-(doubles a, doubles b) { return {_mm256_sub_pd(a.v, b.v)}; }
+    inline doubles operator*(doubles a, doubles b) { return {_mm256_mul_pd(a.v, b.v)}; }
+    inline doubles operator/(doubles a, doubles b) { return {_mm256_div_pd(a.v, b.v)}; }
+
+    inline bools operator<(doubles a, doubles b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)}; }
+    inline bools operator>(doubles a, doubles b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ)}; }
+    inline bools operator<=(doubles a, doubles b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)}; }
+    inline bools operator>=(doubles a, doubles b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ)}; }
+    inline bools operator==(doubles a, doubles b) { return {_mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ)}; }
+
+    inline bools operator&(bools a, bools b) { return {_mm256_and_pd(a.v, b.v)}; }
+    inline bools operator|(bools a, bools b) { return {_mm256_or_pd(a.v, b.v)}; }
+
+    // One bit per lane
+    inline int bits(bools a) { return _mm256_movemask_pd(a.v); }
+
+    inline void store(double *p, doubles a) { _mm256_store_pd(p, a.v); }
+#elif defined(__SSE2__)
+    struct doubles { __m128d lo, hi; };
+    struct bools { __m128d lo, hi; };
+
+    inline doubles load(const double *p) { return {_mm_load_pd(p), _mm_load_pd(p + 2)}; }
+    inline doubles set(double x) { return {_mm_set1_pd(x), _mm_set1_pd(x)}; }
+
+    inline doubles operator+(doubles a, doubles b) { return {_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)}; }
+    inline doubles operator-(doubles a, doubles b) { return {_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)}; }
+    inline doubles operator*(doubles a, doubles b) { return {_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)}; }
+    inline doubles operator/(doubles a, doubles b) { return {_mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi)}; }
+
+    inline bools operator<(doubles a, doubles b) { return {_mm_cmplt_pd(a.lo, b.lo), _mm_cmplt_pd(a.hi, b.hi)}; }
+    inline bools operator>(doubles a, doubles b) { return {_mm_cmpgt_pd(a.lo, b.lo), _mm_cmpgt_pd(a.hi, b.hi)}; }
+    inline bools operator<=(doubles a, doubles b) { return {_mm_cmple_pd(a.lo, b.lo), _mm_cmple_pd(a.hi, b.hi)}; }
+    inline bools operator>=(doubles a, doubles b) { return {_mm_cmpge_pd(a.lo, b.lo), _mm_cmpge_pd(a.hi, b.hi)}; }
+    inline bools operator==(doubles a, doubles b) { return {_mm_cmpeq_pd(a.lo, b.lo), _mm_cmpeq_pd(a.hi, b.hi)}; }
+
+    inline bools operator&(bools a, bools b) { return {_mm_and_pd(a.lo, b.lo), _mm_and_pd(a.hi, b.hi)}; }
+    inline bools operator|(bools a, bools b) { return {_mm_or_pd(a.lo, b.lo), _mm_or_pd(a.hi, b.hi)}; }
+
+    inline int bits(bools a) { return _mm_movemask_pd(a.lo) | (_mm_movemask_pd(a.hi) << 2); }
+
+    inline void store(double *p, doubles a) { _mm_store_pd(p, a.lo); _mm_store_pd(p + 2, a.hi); }
+#else
+    struct doubles { double v[TRIANGLE_PACKET_WIDTH]; };
+    struct bools { bool v[TRIANGLE_PACKET_WIDTH]; };
+
+#define SIMD_LANES(r, expr) for (int i = 0; i < TRIANGLE_PACKET_WIDTH; i++) r.v[i] = (expr); return r;
+
+    inline doubles load(const double *p) { doubles r{}; SIMD_LANES(r, p[i]) }
+    inline doubles set(double x) { doubles r{}; SIMD_LANES(r, x) }
+
+    inline doubles operator+(doubles a, doubles b) { doubles r{}; SIMD_LANES(r, a.v[i] + b.v[i]) }
+    inline doubles operator-(doubles a, doubles b) { doubles r{}; SIMD_LANES(r, a.v[i] - b.v[i]) }
+    inline doubles operator*(doubles a, doubles b) { doubles r{}; SIMD_LANES(r, a.v[i] * b.v[i]) }
+    inline doubles operator/(doubles a, doubles b) { doubles r{}; SIMD_LANES(r, a.v[i] / b.v[i]) }
+
+    inline bools operator<(doubles a, doubles b) { bools r{}; SIMD_LANES(r, a.v[i] < b.v[i]) }
+    inline bools operator>(doubles a, doubles b) { bools r{}; SIMD_LANES(r, a.v[i] > b.v[i]) }
+    inline bools operator<=(doubles a, doubles b) { bools r{}; SIMD_LANES(r, a.v[i] <= b.v[i]) }
+    inline bools operator>=(doubles a, doubles b) { bools r{}; SIMD_LANES(r, a.v[i] >= b.v[i]) }
+    inline bools operator==(doubles a, doubles b) { bools r{}; SIMD_LANES(r, a.v[i] == b.v[i]) }
+
+    inline bools operator&(bools a, bools b) { bools r{}; SIMD_LANES(r, a.v[i] && b.v[i]) }
+    inline bools operator|(bools a, bools b) { bools r{}; SIMD_LANES(r, a.v[i] || b.v[i]) }
+
+#undef SIMD_LANES
+
+    inline int bits(bools a) {
+        int r = 0;
+        for (int i = 0; i < TRIANGLE_PACKET_WIDTH; i++) r |= a.v[i] << i;
+        return r;
+    }
+
+    inline void store(double *p, doubles a) {
+        for (int i = 0; i < TRIANGLE_PACKET_WIDTH; i++) p[i] = a.v[i];
+    }
+#endif
+}
+
+// Up to TRIANGLE_PACKET_WIDTH triangles, unused lanes are never reported as hits
+struct alignas(32) TrianglePacket {
+    // a[axis][lane]
+    double a[3][TRIANGLE_PACKET_WIDTH]{}, b[3][TRIANGLE_PACKET_WIDTH]{}, c[3][TRIANGLE_PACKET_WIDTH]{};
+    double parallel_tolerance[TRIANGLE_PACKET_WIDTH]{};
+
+    // Id of the triangle stored in each lane, chosen by the owner of the packet
+    uint32_t primitive[TRIANGLE_PACKET_WIDTH]{};
+    int count = 0;
+
+    [[nodiscard]] bool full() const {
+        return count == TRIANGLE_PACKET_WIDTH;
+    }
+
+    void add(const Vector3d &_a, const Vector3d &_b, const Vector3d &_c, uint32_t _primitive) {
+        for (int axis = 0; axis < 3; axis++) {
+            a[axis][count] = _a[axis];
+            b[axis][count] = _b[axis];
+            c[axis][count] = _c[axis];
+        }
+        parallel_tolerance[count] = PrecomputedTriangle(_a, _b, _c).parallel_tolerance;
+        primitive[count] = _primitive;
+        count++;
+    }
+};
+
+namespace {
+    // Same steps as moller_trumbore() in TriangleIntersection.hpp, for every lane
+    inline int moller_trumbore_lanes(const TrianglePacket &p, const Ray &ray,
+                                     double *t, double *u, double *v) {
+        using namespace simd;
+        const Vector3d &o = ray.origin.v, &d = ray.direction.v;
+        doubles dx = set(d[0]), dy = set(d[1]), dz = set(d[2]);
+
+        doubles ax = load(p.a[0]), ay = load(p.a[1]), az = load(p.a[2]);
+        doubles e1x = load(p.b[0]) - ax, e1y = load(p.b[1]) - ay, e1z = load(p.b[2]) - az;
+        doubles e2x = load(p.c[0]) - ax, e2y = load(p.c[1]) - ay, e2z = load(p.c[2]) - az;
+
+        // h = d x edge2
+        doubles hx = dy * e2z - dz * e2y;
+        doubles hy = dz * e2x - dx * e2z;
+        doubles hz = dx * e2y - dy * e2x;
+        doubles det = e1x * hx + e1y * hy + e1z * hz;
+
+        doubles tolerance = load(p.parallel_tolerance);
+        int parallel = bits((det > set(0) - tolerance) & (det < tolerance));
+
+        doubles f = set(1.0) / det;
+        doubles sx = set(o[0]) - ax, sy = set(o[1]) - ay, sz = set(o[2]) - az;
+        doubles U = f * (sx * hx + sy * hy + sz * hz);
+
+        // q = s x edge1
+        doubles qx = sy * e1z - sz * e1y;
+        doubles qy = sz * e1x - sx * e1z;
+        doubles qz = sx * e1y - sy * e1x;
+        doubles V = f * (dx * qx + dy * qy + dz * qz);
+        doubles T = f * (e2x * qx + e2y * qy + e2z * qz);
+
+        int inside = bits((U >= set(0)) & (U <= set(1)) & (V >= set(0)) & (U + V <= set(1)) &
+                          (T > set(TRIANGLE_MIN_T)));
+
+        store(t, T);
+        store(u, U);
+        store(v, V);
+        return inside & ~parallel;
+    }
+
+    // Same steps as watertight() in TriangleIntersection.hpp, for every lane. The shear only depends on
+    // the ray, so it is computed once for the whole packet
+    inline int watertight_lanes(const TrianglePacket &p, const Ray &ray,
+                                double *t, double *u, double *v) {
+        using namespace simd;
+        const Vector3d &dir = ray.direction.v;
+
+        int kz = 0;
+        if (std::abs(dir[1]) > std::abs(dir[kz])) kz = 1;
+        if (std::abs(dir[2]) > std::abs(dir[kz])) kz = 2;
+        int kx = (kz + 1) % 3;
+        int ky = (kx + 1) % 3;
+        if (dir[kz] < 0) std::swap(kx, ky);
+
+        doubles Sx = set(dir[kx] / dir[kz]);
+        doubles Sy = set(dir[ky] / dir[kz]);
+        doubles Sz = set(1.0 / dir[kz]);
+        doubles ox = set(ray.origin.v[kx]), oy = set(ray.origin.v[ky]), oz = set(ray.origin.v[kz]);
+
+        doubles Az = load(p.a[kz]) - oz, Bz = load(p.b[kz]) - oz, Cz = load(p.c[kz]) - oz;
+        doubles Ax = (load(p.a[kx]) - ox) - Sx * Az, Ay = (load(p.a[ky]) - oy) - Sy * Az;
+        doubles Bx = (load(p.b[kx]) - ox) - Sx * Bz, By = (load(p.b[ky]) - oy) - Sy * Bz;
+        doubles Cx = (load(p.c[kx]) - ox) - Sx * Cz, Cy = (load(p.c[ky]) - oy) - Sy * Cz;
+
+        doubles U = Cx * By - Cy * Bx;
+        doubles V = Ax * Cy - Ay * Cx;
+        doubles W = Bx * Ay - By * Ax;
+
+        doubles zero = set(0);
+        int outside = bits((U < zero) | (V < zero) | (W < zero)) & bits((U > zero) | (V > zero) | (W > zero));
+
+        doubles det = U + V + W;
+        int degenerate = bits(det == zero);
+
+        doubles T = U * Sz * Az + V * Sz * Bz + W * Sz * Cz;
+        doubles inv_det = set(1.0) / det;
+        doubles t_lanes = T * inv_det;
+        int in_front = bits(t_lanes > set(TRIANGLE_MIN_T));
+
+        store(t, t_lanes);
+        store(u, V * inv_det);
+        store(v, W * inv_det);
+        return in_front & ~outside & ~degenerate;
+    }
+}
+
+// Returns the lane of the closest triangle hit by the ray (or -1), and its t and (u, v) barycentric coordinates
+inline int triangle_packet_collides(const TrianglePacket &packet, const Ray &ray, double &t, double &u, double &v) {
+#ifdef benchmarking
+    for (int i = 0; i < packet.count; i++) Benchmarking::count_figure_checked();
+#endif
+    alignas(32) double t_lanes[TRIANGLE_PACKET_WIDTH], u_lanes[TRIANGLE_PACKET_WIDTH], v_lanes[TRIANGLE_PACKET_WIDTH];
+
+    int hits = (triangle_intersection_method == WATERTIGHT) ?
+                    watertight_lanes(packet, ray, t_lanes, u_lanes, v_lanes) :
+                    moller_trumbore_lanes(packet, ray, t_lanes, u_lanes, v_lanes);
+    hits &= (1 << packet.count) - 1;
+
+    int closest = -1;
+    for (int i = 0; i < packet.count; i++) {
+        if ((hits >> i & 1) && (closest < 0 || t_lanes[i] < t_lanes[closest])) closest = i;
+    }
+
+    if (closest >= 0) {
+        t = t_lanes[closest];
+        u = u_lanes[closest];
+        v = v_lanes[closest];
+    }
+    return closest;
+}
+
+#endif //INFORMATICA_GRAFICA_TRIANGLEPACKET_HPP
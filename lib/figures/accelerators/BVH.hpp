@@ -17,9 +17,12 @@
 #ifndef INFORMATICA_GRAFICA_BVH_HPP
 #define INFORMATICA_GRAFICA_BVH_HPP
 
+#include <cstdint>
 #include <memory>
 #include <random>
 #include "Figure.hpp"
+#include "TrianglePacket.hpp"
+#include "PrimitiveStore.hpp"
 #include "../../lib/Scene.hpp"
 
 enum BvhMethod {
@@ -27,16 +30,83 @@ enum BvhMethod {
     CENTROID
 };
 
+// A leaf full of triangles fits in a single packet
+#define BVH_MAX_PRIMITIVES_PER_LEAF TRIANGLE_PACKET_WIDTH
+
 class BVH : public Figure {
 public:
-    explicit BVH(const Scene &scene, BvhMethod method) : BVH(scene.figures, 0, scene.figures.size(), method, true) {
+    explicit BVH(const Scene &scene, BvhMethod method) : figures(scene.figures) {
+        // Every leaf shares (and keeps alive) the store, through its primitives
+        auto store = std::make_shared<PrimitiveStore>(figures);
+        auto all_primitives = std::shared_ptr<std::vector<BVHPrimitive>>(store, &store->primitives);
+
+        watcher = std::thread(watch_bvh_construction, all_primitives->size()+1);
+        build(all_primitives, 0, all_primitives->size(), method);
         watcher.join();
     }
 
-    BVH(const std::vector<std::shared_ptr<Figure>> &figures, size_t start, size_t end, BvhMethod method, bool first_call) {
-        if (first_call) watcher = std::thread(watch_bvh_construction, end+1);
+    BVH(const std::shared_ptr<std::vector<BVHPrimitive>> &all_primitives, size_t start, size_t end, BvhMethod method) {
+        build(all_primitives, start, end, method);
+    }
+
+    TraversalHit collides(const Ray &ray) const override {
+#ifdef benchmarking
+        Benchmarking::count_hit_record_returned();
+#endif
+        if (!std::get<0>(box.collides(ray))) return {};
+
+        if (is_leaf()) {
+            TraversalHit hit;
+            size_t first_scalar = leaf_start;
+
+            // Triangles are stored first in the leaf's range and tested all at once
+            if (packet != nullptr) {
+                double t, u, v;
+                int lane = triangle_packet_collides(*packet, ray, t, u, v);
+                if (lane >= 0) {
+                    const BVHPrimitive &primitive = (*primitives)[packet->primitive[lane]];
+                    hit = primitive.figure->triangle_hit(primitive.index, t, u, v);
+                }
+                first_scalar += packet->count;
+            }
+
+            for (size_t i = first_scalar; i < leaf_end; i++) {
+#ifdef benchmarking
+                Benchmarking::count_hit_record_returned();
+#endif
+                TraversalHit temp = (*primitives)[i].collides(ray);
+
+                if (temp.hits && (!hit.hits || temp.t < hit.t)) hit = temp;
+            }
+
+            return hit;
+        }
+
+        TraversalHit hit_left = left->collides(ray);
+        TraversalHit hit_right = right->collides(ray);
+
+        if (hit_left.hits && hit_right.hits) {
+            if (hit_left.t < hit_right.t) return hit_left;
+            else return hit_right;
+        }
+        else if (hit_left.hits) return hit_left;
+        else if (hit_right.hits) return hit_right;
+        else return {};
+    }
+
+    Bounds3d bounds() const override {
+        return box;
+    }
+
+    [[nodiscard]] bool is_leaf() const {
+        return left == nullptr;
+    }
 
-        auto objects = figures;
+private:
+    // Primitives are sorted in place, so each node only touches its own [start, end) range and leaves can
+    // reference it directly
+    void build(const std::shared_ptr<std::vector<BVHPrimitive>> &all_primitives, size_t start, size_t end, BvhMethod method) {
+        std::vector<BVHPrimitive> &objects = *all_primitives;
 
         //size_t axis = random_axis();
 
@@ -46,7 +116,7 @@ public:
         //  its figures are more spread out across that axis
         Bounds3d centroid_bounds;
         for (unsigned long i = start; i < end; ++i) {
-            Bounds3d bounds = figures[i]->bounds();
+            Bounds3d bounds = objects[i].bounds();
             Vector3d centroid = bounds.p_min.v/2 + bounds.p_max.v/2;
             centroid_bounds = centroid_bounds.Union(Point(centroid));
         }
@@ -60,77 +130,73 @@ public:
 
         size_t object_span = end - start;
 
-        if (object_span == 1) {
-            figures_inserted++;
-
-            // Simplifies construction at the cost of colliding twice here
-            left = right = objects[start];
-        } else if (object_span == 2) {
-            figures_inserted += 2;
-
-            // Smaller bounding box on the left size, bigger on the right
-            if (comparator(objects[start], objects[start+1])) {
-                left = objects[start];
-                right = objects[start+1];
-            } else {
-                left = objects[start+1];
-                right = objects[start];
-            }
-        } else {
-            size_t mid = start + object_span/2;
+        if (object_span <= BVH_MAX_PRIMITIVES_PER_LEAF) {
+            figures_inserted += object_span;
+
+            primitives = all_primitives;
+            leaf_start = start;
+            leaf_end = end;
+
+            box = Bounds3d();
+            for (size_t i = start; i < end; i++) box = box.Union(objects[i].bounds());
+
+            // Primitives of the same type are tested one after the other
+            std::stable_sort(objects.begin() + start, objects.begin() + end,
+                             [](const BVHPrimitive &a, const BVHPrimitive &b) { return a.type < b.type; });
+            pack_triangles(objects);
+            return;
+        }
 
-            if (method == SORT) {
-                // Sort all figures from lesser to greater position on the current axis
+        size_t mid = start + object_span/2;
+
+        if (method == SORT) {
+            // Sort all figures from lesser to greater position on the current axis
+            std::sort(objects.begin() + start, objects.begin() + end, comparator);
+        } else if (method == CENTROID) {
+            // Sort all figures based on the midpoint rule of the centroids
+            double pmid = (centroid_bounds.p_min[axis] + centroid_bounds.p_max[axis] ) / 2;
+            auto mid_ptr =
+                    std::partition(objects.begin() + start, objects.begin() + end,
+                                   [axis, pmid](const BVHPrimitive &f) {
+                                       auto bounds_f = f.bounds();
+                                       auto centroid = bounds_f.p_min.v/2 + bounds_f.p_max.v/2;
+                                       return centroid[axis] < pmid;
+                                   });
+
+            mid = mid_ptr - objects.begin();
+
+            // If sorting failed, use the original method
+            if (mid == end || mid == start) {
+                mid = start + object_span/2;
                 std::sort(objects.begin() + start, objects.begin() + end, comparator);
-            } else if (method == CENTROID) {
-                // Sort all figures based on the midpoint rule of the centroids
-                double pmid = (centroid_bounds.p_min[axis] + centroid_bounds.p_max[axis] ) / 2;
-                auto mid_ptr =
-                        std::partition(&objects[start], &objects[end - 1] + 1,
-                                       [axis, pmid](const std::shared_ptr<Figure> &f) {
-                                           auto bounds_f = f->bounds();
-                                           auto centroid = bounds_f.p_min.v/2 + bounds_f.p_max.v/2;
-                                           return centroid[axis] < pmid;
-                                       });
-
-                mid = mid_ptr - &objects[0];
-
-                // If sorting failed, use the original method
-                if (mid == end || mid == start) {
-                    mid = start + object_span/2;
-                    std::sort(objects.begin() + start, objects.begin() + end, comparator);
-                }
             }
-
-            left = std::make_shared<BVH>(objects, start, mid, method, false);
-            right = std::make_shared<BVH>(objects, mid, end, method, false);
         }
 
+        left = std::make_shared<BVH>(all_primitives, start, mid, method);
+        right = std::make_shared<BVH>(all_primitives, mid, end, method);
+
         Bounds3d box_left = left->bounds();
         Bounds3d box_right = right->bounds();
         box = box_left.Union(box_right);
     }
 
-    HitRegister collides(const Ray &ray) const override {
-        if (!std::get<0>(box.collides(ray))) return {};
-
-        HitRegister hit_left = left->collides(ray);
-        HitRegister hit_right = right->collides(ray);
-
-        if (hit_left.hits && hit_right.hits) {
-            if (hit_left.t < hit_right.t) return hit_left;
-            else return hit_right;
+    // Moves the leaf's triangles to the beginning of its range and packs them
+    void pack_triangles(std::vector<BVHPrimitive> &objects) {
+        auto is_triangle = [](const BVHPrimitive &p) {
+            Vector3d a, b, c;
+            return p.figure->primitive_triangle(p.index, a, b, c);
+        };
+        auto triangles_end = std::stable_partition(objects.begin() + leaf_start, objects.begin() + leaf_end, is_triangle);
+        if (triangles_end == objects.begin() + leaf_start) return;
+
+        packet = std::make_shared<TrianglePacket>();
+        for (auto it = objects.begin() + leaf_start; it != triangles_end; ++it) {
+            Vector3d a, b, c;
+            it->figure->primitive_triangle(it->index, a, b, c);
+            packet->add(a, b, c, (uint32_t) (it - objects.begin()));
         }
-        else if (hit_left.hits) return hit_left;
-        else if (hit_right.hits) return hit_right;
-        else return {};
     }
 
-    Bounds3d bounds() const override {
-        return box;
-    }
-
-private:
     inline size_t random_axis() {
         std::mt19937 gen = std::mt19937((std::random_device()()));
         std::uniform_int_distribution<size_t> axis_distr = std::uniform_int_distribution<size_t>(0, 2);
@@ -138,20 +204,20 @@ private:
         return axis_distr(gen);
     }
 
-    static inline bool box_compare(const std::shared_ptr<Figure> &a, const std::shared_ptr<Figure> &b, int axis) {
-        return a->bounds().p_min[axis] < b->bounds().p_min[axis];
+    static inline bool box_compare(const BVHPrimitive &a, const BVHPrimitive &b, int axis) {
+        return a.bounds().p_min[axis] < b.bounds().p_min[axis];
     }
 
 
-    static bool box_x_compare (const std::shared_ptr<Figure> &a, const std::shared_ptr<Figure> &b) {
+    static bool box_x_compare (const BVHPrimitive &a, const BVHPrimitive &b) {
         return box_compare(a, b, 0);
     }
 
-    static bool box_y_compare (const std::shared_ptr<Figure> &a, const std::shared_ptr<Figure> &b) {
+    static bool box_y_compare (const BVHPrimitive &a, const BVHPrimitive &b) {
         return box_compare(a, b, 1);
     }
 
-    static bool box_z_compare (const std::shared_ptr<Figure> &a, const std::shared_ptr<Figure> &b) {
+    static bool box_z_compare (const BVHPrimitive &a, const BVHPrimitive &b) {
         return box_compare(a, b, 2);
     }
 
@@ -168,10 +234,18 @@ private:
     }
 
 public:
-    std::shared_ptr<Figure> left;
-    std::shared_ptr<Figure> right;
+    std::shared_ptr<BVH> left;
+    std::shared_ptr<BVH> right;
     Bounds3d box;
 
+    // Only for leaves: range of primitives contained in the leaf
+    std::shared_ptr<const std::vector<BVHPrimitive>> primitives;
+    size_t leaf_start{0}, leaf_end{0};
+    std::shared_ptr<TrianglePacket> packet;
+
+    // Only for the root: keeps the figures alive once they are removed from the scene
+    std::vector<std::shared_ptr<Figure>> figures;
+
     static std::atomic<size_t> figures_inserted;
     static std::thread watcher;
 };
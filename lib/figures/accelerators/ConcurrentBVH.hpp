@@ -49,11 +49,11 @@ public:
     }
 
 public:
-    HitRegister collides(const Ray &ray) const override {
+    TraversalHit collides(const Ray &ray) const override {
         if (!std::get<0>(box.collides(ray))) return {};
 
-        HitRegister hit_left = left->collides(ray);
-        HitRegister hit_right = right->collides(ray);
+        TraversalHit hit_left = left->collides(ray);
+        TraversalHit hit_right = right->collides(ray);
 
         if (hit_left.hits && hit_right.hits) {
             if (hit_left.t < hit_right.t) return hit_left;
@@ -0,0 +1,143 @@
+//
+// PrimitiveStore.hpp
+//
+// Description:
+//  Primitives of the scene, sorted by type for the accelerators. Figures of the most common types are copied
+//  into one contiguous array per type, and each primitive keeps a type tag, so the BVH leaves intersect them
+//  with a switch instead of a virtual call (which also lets the compiler inline the intersection). Any other
+//  figure (i.e. CSG or transformed figures) is still intersected through its virtual functions
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_PRIMITIVESTORE_HPP
+#define INFORMATICA_GRAFICA_PRIMITIVESTORE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Figure.hpp"
+#include "Sphere.hpp"
+#include "Plane.hpp"
+#include "Triangle.hpp"
+#include "TriangleMesh.hpp"
+#include "Cylinder.hpp"
+#include "Cone.hpp"
+#include "Disk.hpp"
+#include "Ellipsoid.hpp"
+
+enum PrimitiveType : uint8_t {
+    SPHERE_PRIMITIVE,
+    PLANE_PRIMITIVE,
+    TRIANGLE_PRIMITIVE,
+    CYLINDER_PRIMITIVE,
+    CONE_PRIMITIVE,
+    DISK_PRIMITIVE,
+    ELLIPSOID_PRIMITIVE,
+    MESH_TRIANGLE_PRIMITIVE,
+    GENERIC_PRIMITIVE
+};
+
+// Reference to a single primitive of a figure: the figure itself for simple figures, or one of the triangles
+// of a TriangleMesh. This way meshes don't need a heap allocated figure per triangle
+struct BVHPrimitive {
+    const Figure *figure;
+    uint32_t index;
+    PrimitiveType type;
+
+    [[nodiscard]] TraversalHit collides(const Ray &ray) const {
+        // Qualified calls aren't virtual, so they can be inlined
+        switch (type) {
+            case SPHERE_PRIMITIVE: return static_cast<const Sphere *>(figure)->Sphere::collides(ray);
+            case PLANE_PRIMITIVE: return static_cast<const Plane *>(figure)->Plane::collides(ray);
+            case TRIANGLE_PRIMITIVE: return static_cast<const Triangle *>(figure)->Triangle::collides(ray);
+            case CYLINDER_PRIMITIVE: return static_cast<const Cylinder *>(figure)->Cylinder::collides(ray);
+            case CONE_PRIMITIVE: return static_cast<const Cone *>(figure)->Cone::collides(ray);
+            case DISK_PRIMITIVE: return static_cast<const Disk *>(figure)->Disk::collides(ray);
+            case ELLIPSOID_PRIMITIVE: return static_cast<const Ellipsoid *>(figure)->Ellipsoid::collides(ray);
+            case MESH_TRIANGLE_PRIMITIVE:
+                return static_cast<const TriangleMesh *>(figure)->TriangleMesh::primitive_collides(ray, index);
+            case GENERIC_PRIMITIVE: default: return figure->primitive_collides(ray, index);
+        }
+    }
+
+    [[nodiscard]] Bounds3d bounds() const {
+        return figure->primitive_bounds(index);
+    }
+};
+
+class PrimitiveStore {
+public:
+    std::vector<Sphere> spheres;
+    std::vector<Plane> planes;
+    std::vector<Triangle> triangles;
+    std::vector<Cylinder> cylinders;
+    std::vector<Cone> cones;
+    std::vector<Disk> disks;
+    std::vector<Ellipsoid> ellipsoids;
+
+    // Primitives of all the figures, pointing to the arrays above (or to the figures themselves, for the rest)
+    std::vector<BVHPrimitive> primitives;
+
+    explicit PrimitiveStore(const std::vector<std::shared_ptr<Figure>> &figures) {
+        // Primitives point into the arrays, so they can't grow once filled
+        size_t number_of_spheres = 0, number_of_planes = 0, number_of_triangles = 0, number_of_cylinders = 0,
+               number_of_cones = 0, number_of_disks = 0, number_of_ellipsoids = 0;
+        for (const auto &figure : figures) {
+            const Figure *f = figure.get();
+            if (dynamic_cast<const Sphere *>(f)) number_of_spheres++;
+            else if (dynamic_cast<const Plane *>(f)) number_of_planes++;
+            else if (dynamic_cast<const Triangle *>(f)) number_of_triangles++;
+            else if (dynamic_cast<const Cylinder *>(f)) number_of_cylinders++;
+            else if (dynamic_cast<const Cone *>(f)) number_of_cones++;
+            else if (dynamic_cast<const Disk *>(f)) number_of_disks++;
+            else if (dynamic_cast<const Ellipsoid *>(f)) number_of_ellipsoids++;
+        }
+        spheres.reserve(number_of_spheres);
+        planes.reserve(number_of_planes);
+        triangles.reserve(number_of_triangles);
+        cylinders.reserve(number_of_cylinders);
+        cones.reserve(number_of_cones);
+        disks.reserve(number_of_disks);
+        ellipsoids.reserve(number_of_ellipsoids);
+
+        for (const auto &figure : figures) {
+            const Figure *f = figure.get();
+            if (auto sphere = dynamic_cast<const Sphere *>(f)) {
+                spheres.push_back(*sphere);
+                primitives.push_back(BVHPrimitive{&spheres.back(), 0, SPHERE_PRIMITIVE});
+            } else if (auto plane = dynamic_cast<const Plane *>(f)) {
+                planes.push_back(*plane);
+                primitives.push_back(BVHPrimitive{&planes.back(), 0, PLANE_PRIMITIVE});
+            } else if (auto triangle = dynamic_cast<const Triangle *>(f)) {
+                triangles.push_back(*triangle);
+                primitives.push_back(BVHPrimitive{&triangles.back(), 0, TRIANGLE_PRIMITIVE});
+            } else if (auto cylinder = dynamic_cast<const Cylinder *>(f)) {
+                cylinders.push_back(*cylinder);
+                primitives.push_back(BVHPrimitive{&cylinders.back(), 0, CYLINDER_PRIMITIVE});
+            } else if (auto cone = dynamic_cast<const Cone *>(f)) {
+                cones.push_back(*cone);
+                primitives.push_back(BVHPrimitive{&cones.back(), 0, CONE_PRIMITIVE});
+            } else if (auto disk = dynamic_cast<const Disk *>(f)) {
+                disks.push_back(*disk);
+                primitives.push_back(BVHPrimitive{&disks.back(), 0, DISK_PRIMITIVE});
+            } else if (auto ellipsoid = dynamic_cast<const Ellipsoid *>(f)) {
+                ellipsoids.push_back(*ellipsoid);
+                primitives.push_back(BVHPrimitive{&ellipsoids.back(), 0, ELLIPSOID_PRIMITIVE});
+            } else {
+                PrimitiveType type = dynamic_cast<const TriangleMesh *>(f) ? MESH_TRIANGLE_PRIMITIVE : GENERIC_PRIMITIVE;
+                for (size_t i = 0; i < f->number_of_primitives(); i++) {
+                    primitives.push_back(BVHPrimitive{f, (uint32_t) i, type});
+                }
+            }
+        }
+        primitives.shrink_to_fit();
+    }
+};
+
+#endif //INFORMATICA_GRAFICA_PRIMITIVESTORE_HPP
@@ -24,11 +24,11 @@ public:
 
     Direction() = default;
 
-    Direction(double x, double y, double z) : v(x, y, z) {}
+    Direction(Real x, Real y, Real z) : v(x, y, z) {}
 
     Direction(Vector3d v) : v(v) {}
 
-    double operator[](int i) const {
+    Real operator[](int i) const {
         return v[i];
     }
 };
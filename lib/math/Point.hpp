@@ -24,7 +24,7 @@ public:
 
     Point() = default;
 
-    Point(double x, double y, double z) : v(x, y, z) {}
+    Point(Real x, Real y, Real z) : v(x, y, z) {}
 
     explicit Point(Vector3d _v) : v(_v) {}
 
@@ -32,7 +32,7 @@ public:
         return Point(v + d.v);
     }
 
-    double operator[](int i) const {
+    Real operator[](int i) const {
         return v[i];
     }
 };
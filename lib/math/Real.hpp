@@ -0,0 +1,25 @@
+//
+// Real.hpp
+//
+// Description:
+//  Scalar type of the geometry: vectors, points, directions, transformation matrices and bounding boxes.
+//  Double precision by default, single precision when built with -DSINGLE_PRECISION=ON
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_REAL_HPP
+#define INFORMATICA_GRAFICA_REAL_HPP
+
+#ifdef single_precision
+typedef float Real;
+#else
+typedef double Real;
+#endif
+
+#endif //INFORMATICA_GRAFICA_REAL_HPP
@@ -21,13 +21,13 @@
 
 class TransformationMatrix {
 private:
-    double m[4][4]{};
+    Real m[4][4]{};
 
 public:
-    explicit TransformationMatrix(double t00, double t01, double t02, double t03,
-                                  double t10, double t11, double t12, double t13,
-                                  double t20, double t21, double t22, double t23,
-                                  double t30, double t31, double t32, double t33) {
+    explicit TransformationMatrix(Real t00, Real t01, Real t02, Real t03,
+                                  Real t10, Real t11, Real t12, Real t13,
+                                  Real t20, Real t21, Real t22, Real t23,
+                                  Real t30, Real t31, Real t32, Real t33) {
         m[0][0] = t00; m[1][0] = t10; m[2][0] = t20; m[3][0] = t30;
         m[0][1] = t01; m[1][1] = t11; m[2][1] = t21; m[3][1] = t31;
         m[0][2] = t02; m[1][2] = t12; m[2][2] = t22; m[3][2] = t32;
@@ -83,6 +83,10 @@ public:
                                     0.0, 0.0, 0.0, 1.0);
     }
 
+    Real operator()(int i, int j) const {
+        return m[i][j];
+    }
+
     TransformationMatrix transpose() const{
         return TransformationMatrix(m[0][0], m[1][0], m[2][0], m[3][0],
                                     m[0][1], m[1][1], m[2][1], m[3][1],
@@ -112,15 +116,15 @@ public:
         return v;
     }
 
-    TransformationMatrix operator *(double f) {
+    TransformationMatrix operator *(Real f) {
         return TransformationMatrix(m[0][0]*f, m[0][1]*f, m[0][2]*f, m[0][3]*f,
                                     m[1][0]*f, m[1][1]*f, m[1][2]*f, m[1][3]*f,
                                     m[2][0]*f, m[2][1]*f, m[2][2]*f, m[2][3]*f,
                                     m[3][0]*f, m[3][1]*f, m[3][2]*f, m[3][3]*f);
     }
 
-    TransformationMatrix operator /(double f) {
-        return *this * (1.0f/f);
+    TransformationMatrix operator /(Real f) {
+        return *this * (1/f);
     }
 
     // Adapted from MESA's (?) implementation:
@@ -128,7 +132,7 @@ public:
     //      https://www.mathsisfun.com/algebra/matrix-inverse-minors-cofactors-adjugate.html
     TransformationMatrix inverse() const{
         TransformationMatrix inv;
-        double det;
+        Real det;
 
         inv.m[0][0] = m[1][1] * m[2][2]* m[3][3]-
                     m[1][1] * m[2][3]* m[3][2]-
@@ -265,5 +269,37 @@ public:
     }
 };
 
+// Affine transformation (the last row of the matrix is always 0 0 0 1), stored as 3x4. Applying it costs
+// a third of a full 4x4 product, which matters when it is done for every ray
+class AffineTransformation {
+private:
+    Real m[3][4]{};
+
+public:
+    AffineTransformation() = default;
+
+    explicit AffineTransformation(const TransformationMatrix &t) {
+        for (int i = 0; i < 3; ++i)
+            for (int j = 0; j < 4; ++j)
+                m[i][j] = t(i, j);
+    }
+
+    Real operator()(int i, int j) const {
+        return m[i][j];
+    }
+
+    [[nodiscard]] Vector3d point(const Vector3d &p) const {
+        return {m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+                m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+                m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]};
+    }
+
+    [[nodiscard]] Vector3d direction(const Vector3d &d) const {
+        return {m[0][0] * d[0] + m[0][1] * d[1] + m[0][2] * d[2],
+                m[1][0] * d[0] + m[1][1] * d[1] + m[1][2] * d[2],
+                m[2][0] * d[0] + m[2][1] * d[1] + m[2][2] * d[2]};
+    }
+};
+
 
 #endif //INFORMATICA_GRAFICA_TRANSFORMATIONMATRIX_HPP
@@ -18,10 +18,11 @@
 
 #include <math.h>
 #include <iostream>
+#include "Real.hpp"
 
 class Vector3d {
 public:
-    double c[3]{};
+    Real c[3]{};
 
     Vector3d() {
         c[0] = 0.0;
@@ -29,7 +30,7 @@ public:
         c[2] = 0.0;
     }
 
-    Vector3d(double x, double y, double z) {
+    Vector3d(Real x, Real y, Real z) {
         c[0] = x;
         c[1] = y;
         c[2] = z;
@@ -61,42 +62,42 @@ public:
         return {x, y, z};
     }
 
-    double dot(const Vector3d v) const {
+    Real dot(const Vector3d v) const {
         return c[0] * v.c[0] + c[1] * v.c[1] + c[2] * v.c[2];
     }
 
 
-    // Vector op double
+    // Vector op scalar
 
-    Vector3d operator *(const double s) const {
+    Vector3d operator *(const Real s) const {
         return {c[0] * s , c[1] * s, c[2] * s};
     }
 
-    friend Vector3d operator *(const double s, const Vector3d v) {
+    friend Vector3d operator *(const Real s, const Vector3d v) {
         return {v.c[0] * s , v.c[1] * s, v.c[2] * s};
     }
 
-    Vector3d operator /(const double s) const {
+    Vector3d operator /(const Real s) const {
         return (*this * (1/s));
     }
 
-    friend Vector3d operator /(const double s, const Vector3d v) {
+    friend Vector3d operator /(const Real s, const Vector3d v) {
         return (v * (1/s));
     }
 
     // Misc. operators
-    double operator[](int i) const {
+    Real operator[](int i) const {
         return c[i];
     }
 
-    double& operator[](int i) {
+    Real& operator[](int i) {
         return c[i];
     }
 
     // Misc. methods
 
     //modulus <-> length
-    double modulus() const {
+    Real modulus() const {
         return sqrt(c[0]*c[0] + c[1]*c[1]  + c[2]*c[2]);
     }
 
@@ -37,13 +37,26 @@ enum Event {
 };
 
 
-Event russian_roulette(const HitRegister &reg) {
+// Computes the surface (normal and texel) of the closest hit and looks up its material in the scene, once
+// traversal is over
+const Material &surface_at_closest_hit(const Scene &scene, const Ray &ray, HitRegister &reg) {
+    reg.figure->surface_interaction(ray, reg);
+    reg.bound_error(ray);
+
+    const Material &material = scene.materials[reg.material_id];
+    if (!material.has_texture) reg.diffuse_coefficient = material.diffuse_coefficient;
+
+    return material;
+}
+
+
+Event russian_roulette(const HitRegister &reg, const Material &material) {
     static std::mt19937 gen = std::mt19937(std::random_device()());
     static std::uniform_real_distribution<double> distr = std::uniform_real_distribution<double>(0, 1.0);
 
     double p_d = std::max(std::max(reg.diffuse_coefficient[0], reg.diffuse_coefficient[1]), reg.diffuse_coefficient[2]);
-    double p_s = std::max(std::max(reg.reflection_coefficient[0], reg.reflection_coefficient[1]), reg.reflection_coefficient[2]);
-    double p_t = std::max(std::max(reg.refraction_coefficient[0], reg.refraction_coefficient[1]), reg.refraction_coefficient[2]);
+    double p_s = std::max(std::max(material.reflection_coefficient[0], material.reflection_coefficient[1]), material.reflection_coefficient[2]);
+    double p_t = std::max(std::max(material.refraction_coefficient[0], material.refraction_coefficient[1]), material.refraction_coefficient[2]);
     double num = distr(gen);
 
     if (num <= p_d) return DIFFUSE;
@@ -53,10 +66,11 @@ Event russian_roulette(const HitRegister &reg) {
 }
 
 
-// Generate a random ray on the hemisphere of a hit point
-Ray brdf_sample(const HitRegister &reg) {
-    static std::mt19937 gen = std::mt19937((std::random_device()()));
-    static std::uniform_real_distribution<double> bsdf_distr = std::uniform_real_distribution<double>(0, 1.0);
+// Generate a random ray on the hemisphere of a hit point, cosine weighted around the normal on the side w_o
+// comes from
+Ray brdf_sample(const HitRegister &reg, const Ray &w_o) {
+    static thread_local std::mt19937 gen = std::mt19937((std::random_device()()));
+    std::uniform_real_distribution<double> bsdf_distr(0, 1.0);
 
     double eThita = bsdf_distr(gen);
     double ePhi = bsdf_distr(gen);
@@ -64,31 +78,39 @@ Ray brdf_sample(const HitRegister &reg) {
     double thita = std::acos(std::sqrt(1-eThita)); // Random [0, pi/2) value
     double phi = 2*M_PI*ePhi; // Random [0, 2pi) value
 
-    // Spherical to cartesian coordinates conversion
-    return {reg.n.origin, Direction(Vector3d(sin(thita)*cos(phi),
-                                             sin(thita)*sin(phi),
-                                             cos(thita)))};
+    // Tangent frame around the normal, which may face away from the ray
+    Vector3d n = reg.n.direction.v;
+    if (n.dot(w_o.direction.v) > 0) n = n * -1;
+    Vector3d t = (std::abs(n[0]) > 0.5 ? Vector3d(0, 1, 0) : Vector3d(1, 0, 0)) * n;
+    t = t.normalize();
+    Vector3d b = n * t;
+
+    // Spherical to cartesian coordinates conversion, in that frame
+    Vector3d direction = t * (sin(thita)*cos(phi)) + b * (sin(thita)*sin(phi)) + n * cos(thita);
+    return {reg.spawn_origin(direction), Direction(direction)};
 }
 
 
-Ray generate_wi(Event event, const HitRegister &reg, const Ray &w_o) {
+Ray generate_wi(Event event, const HitRegister &reg, const Material &material, const Ray &w_o) {
     switch (event) {
         case ABSORPTION: // Should never happend
             return {};
 
         case DIFFUSE:
-            return brdf_sample(reg);
+            return brdf_sample(reg, w_o);
 
-        case SPECULAR:
-            return {Point(reg.n.origin), Direction(w_o.direction.v - 2 * (reg.n.direction.v * (w_o.direction.v.dot(reg.n.direction.v))))};
+        case SPECULAR: {
+            Vector3d direction = w_o.direction.v - 2 * (reg.n.direction.v * (w_o.direction.v.dot(reg.n.direction.v)));
+            return {reg.spawn_origin(direction), Direction(direction)};
+        }
 
         // Adapted from:
         //  https://www.scratchapixel.com/lessons/3d-basic-rendering/introduction-to-shading/reflection-refraction-fresnel
         case REFRACTION:
             Vector3d Nrefr = reg.n.direction.v;
-            double cosi = std::clamp(-1.0, 1.0, (w_o.direction.v).dot(Nrefr));
+            double cosi = std::clamp<double>(-1.0, 1.0, (w_o.direction.v).dot(Nrefr));
             double NdotI = Nrefr.dot(w_o.direction.v);
-            double etai = AIR_REFRACTION, etat = reg.refraction_index;
+            double etai = AIR_REFRACTION, etat = material.refraction_index;
             if (NdotI < 0) {
                 // We are outside the figure's surface, force cos(theta) to be positive
                 NdotI = -NdotI;
@@ -110,11 +132,9 @@ Ray generate_wi(Event event, const HitRegister &reg, const Ray &w_o) {
                 // Total internal reflection, force to be no refraction
                 return {Point(reg.n.origin), Vector3d(0, 0, 0)};
             } else {
-                // Create the refraction's direction
+                // Create the refraction's direction, starting across the surface
                 Direction new_direction = Direction(eta * (w_o.direction.v) + (eta * NdotI - sqrt(k)) * Nrefr);
-                // Advance a bit across the direction in order to avoid colliding with the surface again (start a bit
-                // further from it)
-                return {Point(reg.n.origin.v + (0.01)*new_direction.v), new_direction};
+                return {reg.spawn_origin(new_direction.v), new_direction};
             }
     }
 
@@ -122,7 +142,7 @@ Ray generate_wi(Event event, const HitRegister &reg, const Ray &w_o) {
 }
 
 
-Vector3d material_properties(Event event, const HitRegister &reg) {
+Vector3d material_properties(Event event, const HitRegister &reg, const Material &material) {
     double p;
     switch (event) {
         case DIFFUSE:
@@ -130,14 +150,14 @@ Vector3d material_properties(Event event, const HitRegister &reg) {
                          reg.diffuse_coefficient[2]);
             return reg.diffuse_coefficient / p;
         case SPECULAR:
-            p = std::max(std::max(reg.reflection_coefficient[0], reg.reflection_coefficient[1]),
-                         reg.reflection_coefficient[2]);
-            return (reg.reflection_coefficient / p);
+            p = std::max(std::max(material.reflection_coefficient[0], material.reflection_coefficient[1]),
+                         material.reflection_coefficient[2]);
+            return (material.reflection_coefficient / p);
 
         case REFRACTION:
-            p = std::max(std::max(reg.refraction_coefficient[0], reg.refraction_coefficient[1]),
-                         reg.refraction_coefficient[2]);
-            return (reg.refraction_coefficient / p);
+            p = std::max(std::max(material.refraction_coefficient[0], material.refraction_coefficient[1]),
+                         material.refraction_coefficient[2]);
+            return (material.refraction_coefficient / p);
 
         case ABSORPTION:
         default:
@@ -153,14 +173,15 @@ Vector3d get_contributions_from_direct_lights(const Scene &scene, const HitRegis
     for (PointLight pl : scene.point_lights) {
         auto dir_hit_to_light = Direction((pl.center.v - reg.n.origin.v));
 
-        Ray ray_to_light = Ray(reg.n.origin, dir_hit_to_light);
+        Point origin = reg.spawn_origin(dir_hit_to_light.v);
+        Ray ray_to_light = Ray(origin, dir_hit_to_light);
 
         bool hits_in_path = false;
         // Hit across the scene again, testing for collisions before reaching the point light
         for (const auto& figure : scene.figures) {
-            HitRegister temp = figure->collides(ray_to_light);
+            TraversalHit temp = figure->collides(ray_to_light);
 
-            if (temp.hits && less_than(temp.t, (pl.center.v - reg.n.origin.v).modulus())) {
+            if (temp.hits && less_than(temp.t, (pl.center.v - origin.v).modulus())) {
                 hits_in_path = true;
                 break;
             }
@@ -190,10 +211,11 @@ Vector3d get_contributions_from_direct_lights_bvh(const Scene &scene, const BVH
     for (PointLight pl : scene.point_lights) {
         auto dir_hit_to_light = Direction((pl.center.v - reg.n.origin.v));
 
-        Ray ray_to_light = Ray(reg.n.origin, dir_hit_to_light);
+        Point origin = reg.spawn_origin(dir_hit_to_light.v);
+        Ray ray_to_light = Ray(origin, dir_hit_to_light);
 
-        HitRegister temp = bvh_tree.collides(ray_to_light);
-        bool hits_in_path = temp.hits && less_than(temp.t, (pl.center.v - reg.n.origin.v).modulus());
+        TraversalHit temp = bvh_tree.collides(ray_to_light);
+        bool hits_in_path = temp.hits && less_than(temp.t, (pl.center.v - origin.v).modulus());
 
         if (!hits_in_path) {
             Vector3d radiance = pl.power / (std::pow(dir_hit_to_light.v.modulus(), 2));
@@ -215,19 +237,21 @@ Vector3d integrator_sample_bvh(const Scene &scene, const BVH &bvh_tree, const Ra
 #ifdef benchmarking
     Benchmarking::count_ray_traced();
 #endif
-    HitRegister reg = bvh_tree.collides(ray);
+    HitRegister reg(bvh_tree.collides(ray));
 
     if (!reg.hits) {
         return {0, 0, 0};
     }
 
-    if (reg.is_area_light) {
+    const Material &material = surface_at_closest_hit(scene, ray, reg);
+
+    if (material.is_area_light) {
         // Return the area light's emission
-        return reg.emission;
+        return material.emission;
     } else {
-        Event event = russian_roulette(reg);
-        Ray w_i = generate_wi(event, reg, ray);
-        Vector3d mat_props = material_properties(event, reg);
+        Event event = russian_roulette(reg, material);
+        Ray w_i = generate_wi(event, reg, material, ray);
+        Vector3d mat_props = material_properties(event, reg, material);
 
         // Next-event estimation
         Vector3d direct_light_contributions;
@@ -245,28 +269,31 @@ Vector3d integrator_sample(const Scene &scene, const Ray ray, const size_t numbe
 #ifdef benchmarking
     Benchmarking::count_ray_traced();
 #endif
-    HitRegister reg, temp;
-    reg.t = std::numeric_limits<double>::max();
+    TraversalHit closest, temp;
+    closest.t = std::numeric_limits<double>::max();
 
     for (const auto& figure : scene.figures) {
         temp = figure->collides(ray);
 
-        if (temp.hits  && less_than(temp.t, reg.t)) {
-            reg = temp;
+        if (temp.hits  && less_than(temp.t, closest.t)) {
+            closest = temp;
         }
     }
+    HitRegister reg(closest);
 
     if (!reg.hits) {
         return {0, 0, 0};
     }
 
-    if (reg.is_area_light) {
+    const Material &material = surface_at_closest_hit(scene, ray, reg);
+
+    if (material.is_area_light) {
         // Return the area light's emission
-        return reg.emission;
+        return material.emission;
     } else {
-        Event event = russian_roulette(reg);
-        Ray w_i = generate_wi(event, reg, ray);
-        Vector3d mat_props = material_properties(event, reg);
+        Event event = russian_roulette(reg, material);
+        Ray w_i = generate_wi(event, reg, material, ray);
+        Vector3d mat_props = material_properties(event, reg, material);
 
         // Next-event estimation
         Vector3d direct_light_contributions;
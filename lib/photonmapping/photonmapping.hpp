@@ -15,11 +15,16 @@
 #ifndef INFORMATICA_GRAFICA_PHOTONMAPPING_HPP
 #define INFORMATICA_GRAFICA_PHOTONMAPPING_HPP
 
+#include <algorithm>
 #include <random>
 #include "../Scene.hpp"
 #include "pathtracing.hpp"
 #include "../Photon.hpp"
 #include "photonmapping_kdtree.hpp"
+#include "photonmapping_hashgrid.hpp"
+
+#define PHOTONMAP_NEAREST_PHOTONS 25   // Photons gathered from the KD-tree, whose radius adapts to them
+#define PHOTONMAP_GATHER_RADIUS 0.025  // Radius of the hash grid gathers, which take every photon within it
 
 
 enum PhotonmappingKernel {
@@ -35,46 +40,121 @@ enum PhotonmappingDirectLightMethod {
     STORE_ALL_PHOTONS
 };
 
+#define PHOTON_EMISSION_TOWARDS_SCENE true // Point lights outside of the scene's bounds only emit towards them
+
+// Bounds of every figure of the scene, unbounded if any of them is (i.e. an infinite plane)
+Bounds3d scene_bounds(const Scene &scene) {
+    Bounds3d bounds;
+    for (const auto &figure : scene.figures) bounds = bounds.Union(figure->bounds());
+
+    return bounds;
+}
+
+// Emits the walks of the point lights. Each walk starts from a light chosen with probability proportional to the
+// power it emits, carrying that power divided by the probability, so the photons stay unbiased whenever the emission
+// stops. With several threads, each one of them emits its share of the walks (the thread-th of the threads slices),
+// so they can generate their own rays instead of receiving them from a single producer.
+// The directions of each light follow a low discrepancy sequence (R2, randomly shifted on each generator), mapped to
+// the sphere preserving areas, so they cover it evenly instead of clumping. A light outside of the bounding sphere of
+// the scene only emits within the cone which contains it, since no other walk could hit anything, and its power is
+// scaled by the fraction of the sphere covered by that cone
 class PhotonMapperRayGenerator {
-    std::deque<std::pair<PointLight, size_t>> point_lights;
+    struct EmittingLight {
+        Point center;
+        Vector3d power;              // Emitted within the cone, over the probability of choosing the light
+        Vector3d axis, tangent, bitangent;
+        double cos_max = -1;         // Of the angle of the cone, the whole sphere if -1
+        size_t sample = 0;           // Index of its next direction in the sequence
+    };
+
+    std::vector<EmittingLight> point_lights;
+    std::vector<double> cumulative_probabilities;
+    size_t remaining_walks = 0;
+
+    std::mt19937 gen = std::mt19937((std::random_device()()));
+    std::uniform_real_distribution<double> light_distr = std::uniform_real_distribution<double>(0.0, 1.0);
+    double shift[2] = {0, 0};
+
+    // R2 sequence: additive recurrence on the inverses of the plastic number and its square
+    static constexpr double r2_alpha[2] = {0.7548776662466927, 0.5698402909980532};
+
+    static EmittingLight emitting_light(const PointLight &pl, const Bounds3d &scene_bounds) {
+        EmittingLight light;
+        light.center = pl.center;
+        light.power = pl.power;
+        light.axis = Vector3d(0, 0, 1);
+
+        if (PHOTON_EMISSION_TOWARDS_SCENE && !scene_bounds.is_unbounded()) {
+            Vector3d center = scene_bounds.p_min.v / 2 + scene_bounds.p_max.v / 2;
+            double radius = (scene_bounds.p_max.v - scene_bounds.p_min.v).modulus() / 2;
+            Vector3d to_center = center - pl.center.v;
+            double distance = to_center.modulus();
+
+            if (distance > radius) {
+                light.axis = to_center / distance;
+                light.cos_max = std::sqrt(1 - (radius * radius) / (distance * distance));
+                light.power = pl.power * ((1 - light.cos_max) / 2);
+            }
+        }
+
+        light.tangent = (std::abs(light.axis[0]) > 0.5 ? Vector3d(0, 1, 0) : Vector3d(1, 0, 0)) * light.axis;
+        light.tangent = light.tangent.normalize();
+        light.bitangent = light.axis * light.tangent;
+
+        return light;
+    }
 
 public:
-    PhotonMapperRayGenerator(const std::vector<PointLight>& _point_lights, size_t walks) {
+    PhotonMapperRayGenerator(const std::vector<PointLight>& _point_lights, size_t walks,
+                             size_t thread = 0, size_t threads = 1, const Bounds3d &scene_bounds = Bounds3d()) {
+        std::vector<EmittingLight> lights;
         double sum_of_powers = 0;
-        for (auto pl : _point_lights) {
-            sum_of_powers += std::max(std::max(pl.power[0], pl.power[1]), pl.power[2]);
+        for (const auto &pl : _point_lights) {
+            lights.push_back(emitting_light(pl, scene_bounds));
+            const Vector3d &power = lights.back().power;
+            sum_of_powers += std::max(std::max(power[0], power[1]), power[2]);
         }
+        if (sum_of_powers <= 0) return;
+
+        double accumulated = 0;
+        for (auto &light : lights) {
+            double p = std::max(std::max(light.power[0], light.power[1]), light.power[2]);
+            if (p <= 0) continue;
 
-        for (auto pl : _point_lights) {
-            double p = std::max(std::max(pl.power[0], pl.power[1]), pl.power[2]);
-            point_lights.emplace_back(std::make_pair<>(pl, (double) walks * (p / sum_of_powers)));
+            accumulated += p / sum_of_powers;
+            light.power = light.power / (p / sum_of_powers);
+            point_lights.push_back(light);
+            cumulative_probabilities.push_back(accumulated);
         }
+
+        remaining_walks = walks * (thread + 1) / threads - walks * thread / threads;
+        shift[0] = light_distr(gen);
+        shift[1] = light_distr(gen);
     }
 
     // Create a ray towards any of the point lights. If none is generated (we reached the limit), returns an invalid
     // ray and false
     std::pair<Ray, bool> generate_ray() {
-        if (point_lights.empty()) return std::make_pair<>(Ray(), false);
-
-        static std::mt19937 gen = std::mt19937((std::random_device()()));
-        static std::uniform_real_distribution<double> phi_distr = std::uniform_real_distribution<double>(0, 1.0);
-        static std::uniform_real_distribution<double> thita_distr = std::uniform_real_distribution<double>(0.0, 1.0);
+        if (remaining_walks == 0) return std::make_pair<>(Ray(), false);
+        remaining_walks--;
 
-        double eThita = thita_distr(gen);
-        double ePhi = phi_distr(gen);
+        size_t light = std::upper_bound(cumulative_probabilities.begin(), cumulative_probabilities.end(),
+                                        light_distr(gen)) - cumulative_probabilities.begin();
+        light = std::min(light, point_lights.size() - 1); // Rounding of the last cumulative probability
+        EmittingLight &pl = point_lights[light];
 
-        double thita = std::acos(2*eThita-1); // Random [0, pi) value
-        double phi = 2*M_PI*ePhi; // Random [0, 2pi) value
+        double n = (double) pl.sample++;
+        double eThita = std::fmod(shift[0] + n * r2_alpha[0], 1.0);
+        double ePhi = std::fmod(shift[1] + n * r2_alpha[1], 1.0);
 
-        // SPherical to cartesian coordinates conversion
-        Ray new_ray = Ray(point_lights[0].first.center,
-                          Direction(Vector3d(sin(thita)*cos(phi),
-                                             sin(thita)*sin(phi),
-                                             cos(thita))),
-                          point_lights[0].first.power);
+        // Uniform cosines are uniform areas on the sphere (or on its cap within the cone)
+        double cos_thita = 1 - eThita * (1 - pl.cos_max);
+        double sin_thita = std::sqrt(std::max(0.0, 1 - cos_thita * cos_thita));
+        double phi = 2*M_PI*ePhi; // [0, 2pi) value
 
-        point_lights[0].second--;
-        if (point_lights[0].second == 0)  point_lights.pop_front();
+        // Spherical to cartesian coordinates conversion, around the axis of the light
+        Vector3d direction = pl.tangent * (sin_thita*cos(phi)) + pl.bitangent * (sin_thita*sin(phi)) + pl.axis * cos_thita;
+        Ray new_ray = Ray(pl.center, Direction(direction), pl.power);
 
         return {std::make_pair(new_ray, true)};
     }
@@ -90,24 +170,27 @@ void scatter_photons(const Scene &scene,
 #ifdef benchmarking
     Benchmarking::count_ray_traced();
 #endif
-    HitRegister reg, temp;
-    reg.t = std::numeric_limits<double>::max();
+    TraversalHit closest, temp;
+    closest.t = std::numeric_limits<double>::max();
 
     for (const auto& figure : scene.figures) {
         temp = figure->collides(ray);
 
-        if (temp.hits  && less_than(temp.t, reg.t)) {
-            reg = temp;
+        if (temp.hits  && less_than(temp.t, closest.t)) {
+            closest = temp;
         }
     }
+    HitRegister reg(closest);
 
     if (!reg.hits) return;
 
-    if (reg.is_area_light) {
+    const Material &material = surface_at_closest_hit(scene, ray, reg);
+
+    if (material.is_area_light) {
         return;
     } else {
-        Event event = russian_roulette(reg);
-        Ray w_i = generate_wi(event, reg, ray);
+        Event event = russian_roulette(reg, material);
+        Ray w_i = generate_wi(event, reg, material, ray);
         w_i.flux = ray.flux;
 
         if (event == DIFFUSE && (method == STORE_ALL_PHOTONS || number_of_bounces > 0)) {
@@ -119,7 +202,7 @@ void scatter_photons(const Scene &scene,
                              w_i,
                              number_of_bounces + 1,
                              photons,
-                             throughput.element_by_element(material_properties(event, reg)),
+                             throughput.element_by_element(material_properties(event, reg, material)),
                              method);
         }
     }
@@ -136,15 +219,17 @@ void scatter_photons_bvh(const Scene &scene,
 #ifdef benchmarking
     Benchmarking::count_ray_traced();
 #endif
-    HitRegister reg = bvh_tree.collides(ray);
+    HitRegister reg(bvh_tree.collides(ray));
 
     if (!reg.hits) return;
 
-    if (reg.is_area_light) {
+    const Material &material = surface_at_closest_hit(scene, ray, reg);
+
+    if (material.is_area_light) {
         return;
     } else {
-        Event event = russian_roulette(reg);
-        Ray w_i = generate_wi(event, reg, ray);
+        Event event = russian_roulette(reg, material);
+        Ray w_i = generate_wi(event, reg, material, ray);
         w_i.flux = ray.flux;
 
         if (event == DIFFUSE && (method == STORE_ALL_PHOTONS || number_of_bounces > 0)) {
@@ -157,201 +242,184 @@ void scatter_photons_bvh(const Scene &scene,
                              w_i,
                              number_of_bounces + 1,
                              photons,
-                             throughput.element_by_element(material_properties(event, reg)),
+                             throughput.element_by_element(material_properties(event, reg, material)),
                              method);
         }
     }
 }
 
+enum PhotonMapBackend {
+    KD_TREE,  // Nearest photons
+    HASH_GRID // Photons within a fixed radius
+};
+
+// Photon map lookups, the same for every backend: fill neighbors with the photons around p and return the squared
+// radius they were gathered from
+inline double gather_photons(const PhotonKDTree &photons, const Vector3d &p, PhotonNeighbors &neighbors) {
+    photons.nearest_neighbors(p, PHOTONMAP_NEAREST_PHOTONS, std::numeric_limits<double>::max(), neighbors);
+
+    // Adjust the radius to the farthest photon
+    double max_radio2 = 0;
+    for (const auto &neighbor : neighbors) {
+        max_radio2 = std::max<double>(max_radio2, neighbor.squared_distance);
+    }
+
+    return max_radio2;
+}
+
+inline double gather_photons(const PhotonHashGrid &photons, const Vector3d &p, PhotonNeighbors &neighbors) {
+    photons.gather(p, neighbors);
+    return photons.gather_radius() * photons.gather_radius();
+}
+
+// Flux per unit area around a shading point, from the photons gathered within sqrt(max_radio2) of it
+Vector3d photon_density_estimation(const PhotonNeighbors &neighbors, double max_radio2, PhotonmappingKernel kernel) {
+    double max_radio = sqrt(max_radio2);
+
+    Vector3d flux_sum;
+    switch (kernel) {
+        case BOX:
+            for (const auto &neighbor : neighbors) flux_sum = flux_sum + neighbor.element->flux();
+
+            break;
+
+        case NORMALIZED_BOX:
+            for (const auto &neighbor : neighbors) flux_sum = flux_sum + neighbor.element->flux();
+            flux_sum = flux_sum / (M_PI * max_radio2);
+
+            break;
+
+        case GAUSSIAN:
+            // Gaussian kernel based on:
+            //  https://www.researchgate.net/publication/261793571_Overestimation_and_Underestimation_Biases_in_Photon_Mapping_with_Non-Constant_Kernels
+            for (const auto &neighbor : neighbors) {
+                flux_sum = flux_sum + neighbor.element->flux()*1.728*(1-(1-exp((-1.953*neighbor.squared_distance)/(2*max_radio2)))/(1-exp(-1.953))); // Alpha = 1.728, beta = 1.953
+            }
+
+            break;
+
+        case NORMALIZED_GAUSSIAN:
+            for (const auto &neighbor : neighbors) {
+                flux_sum = flux_sum + neighbor.element->flux()*1.728*(1-(1-exp((-1.953*neighbor.squared_distance)/(2*max_radio2)))/(1-exp(-1.953))); // Alpha = 1.728, beta = 1.953
+            }
+
+            flux_sum = flux_sum / (M_PI * max_radio2);
+
+            break;
+
+        case CONE:
+            for (const auto &neighbor : neighbors) {
+                double d = sqrt(neighbor.squared_distance);
+                flux_sum = flux_sum + neighbor.element->flux() * (1 - d/(1.1*max_radio));
+            }
+
+            flux_sum = flux_sum / ((1 - 2/(3*1.1))* M_PI * max_radio2);
+
+            break;
+    }
+
+    return flux_sum;
+}
+
+// Radiance reflected by a diffuse hit from the photons around it, besides the direct light. Other kinds of photon
+// maps (i.e. the irradiance cache) overload it
+template <typename PhotonMap>
+Vector3d photon_map_radiance_bvh(const Scene &/*scene*/, const BVH &/*bvh_tree*/, const PhotonMap &photons,
+                                 const HitRegister &reg, const Ray &/*ray*/, PhotonmappingKernel kernel,
+                                 PhotonmappingDirectLightMethod /*method*/, PhotonNeighbors &neighbors) {
+    double max_radio2 = gather_photons(photons, reg.n.origin.v, neighbors);
+    Vector3d flux_sum = photon_density_estimation(neighbors, max_radio2, kernel);
+
+    return flux_sum.element_by_element(reg.diffuse_coefficient/M_PI);
+}
+
 // Diffuse BSDF evaluation
+template <typename PhotonMap>
 Vector3d integrator_sample_photonmapping(const Scene &scene,
-                                         const nn::KDTree<Photon, 3, PhotonAxisPosition> &photons,
+                                         const PhotonMap &photons,
                                          const Ray ray,
                                          PhotonmappingKernel kernel,
-                                         PhotonmappingDirectLightMethod method) {
+                                         PhotonmappingDirectLightMethod method,
+                                         PhotonNeighbors &neighbors) {
 #ifdef benchmarking
     Benchmarking::count_ray_traced();
 #endif
-    HitRegister reg, temp;
-    reg.t = std::numeric_limits<double>::max();
+    TraversalHit closest, temp;
+    closest.t = std::numeric_limits<double>::max();
 
     for (const auto& figure : scene.figures) {
         temp = figure->collides(ray);
 
-        if (temp.hits  && less_than(temp.t, reg.t)) {
-            reg = temp;
+        if (temp.hits  && less_than(temp.t, closest.t)) {
+            closest = temp;
         }
     }
+    HitRegister reg(closest);
 
     if (!reg.hits) {
         return {0, 0, 0};
     }
 
-    if (reg.is_area_light) {
+    const Material &material = surface_at_closest_hit(scene, ray, reg);
+
+    if (material.is_area_light) {
         // Return the area light's emission
-        return reg.emission;
+        return material.emission;
     } else {
-        Event event = russian_roulette(reg);
-        Ray w_i = generate_wi(event, reg, ray);
+        Event event = russian_roulette(reg, material);
+        Ray w_i = generate_wi(event, reg, material, ray);
 
         if (event == DIFFUSE) {
             Vector3d direct_light_contributions = get_contributions_from_direct_lights(scene, reg);
 
-            size_t number_of_photons = 25;            // Maximum number of photons to look for
-            //double radius_estimate = 0.1;           // Maximum distance to look for photons
-            auto nearest_neighbors = photons.nearest_neighbors(reg.n.origin.v,
-                                                               number_of_photons,
-                                                               std::numeric_limits<float>::max());
-
-            // Adjust the radius to the farthest photon
-            double max_radio = 0;
-            for (auto photon : nearest_neighbors){
-                max_radio = std::max(max_radio, (reg.n.origin.v - photon->position.v).modulus());
-            }
-
-            Vector3d flux_sum;
-            double d;
-            switch (kernel) {
-                case BOX:
-                    for (auto photon : nearest_neighbors) flux_sum = flux_sum + photon->flux;
-
-                    break;
-
-                case NORMALIZED_BOX:
-                    for (auto photon : nearest_neighbors) flux_sum = flux_sum + photon->flux;
-                    flux_sum = flux_sum / (M_PI * max_radio * max_radio);
-
-                    break;
-
-                case GAUSSIAN:
-                    // Gaussian kernel based on:
-                    //  https://www.researchgate.net/publication/261793571_Overestimation_and_Underestimation_Biases_in_Photon_Mapping_with_Non-Constant_Kernels
-                    for (auto photon : nearest_neighbors) {
-                        d = (reg.n.origin.v - photon->position.v).modulus();
-                        flux_sum = flux_sum + photon->flux*1.728*(1-(1-exp((-1.953*d*d)/(2*max_radio*max_radio)))/(1-exp(-1.953))); // Alpha = 1.728, beta = 1.953
-                    }
-
-                    break;
-
-                case NORMALIZED_GAUSSIAN:
-                    for (auto photon : nearest_neighbors) {
-                        d = (reg.n.origin.v - photon->position.v).modulus();
-                        flux_sum = flux_sum + photon->flux*1.728*(1-(1-exp((-1.953*d*d)/(2*max_radio*max_radio)))/(1-exp(-1.953))); // Alpha = 1.728, beta = 1.953
-                    }
-
-                    flux_sum = flux_sum / (M_PI * max_radio * max_radio);
-
-                    break;
-
-                case CONE:
-                    for (auto photon : nearest_neighbors) {
-                        d = (reg.n.origin.v - photon->position.v).modulus();
-                        flux_sum = flux_sum + photon->flux * (1 - d/(1.1*max_radio)); // Alpha = 1.728, beta = 1.953
-                    }
-
-                    flux_sum = flux_sum / ((1 - 2/(3*1.1))* M_PI * max_radio * max_radio);
-
-                    break;
-            }
-
+            double max_radio2 = gather_photons(photons, reg.n.origin.v, neighbors);
+            Vector3d flux_sum = photon_density_estimation(neighbors, max_radio2, kernel);
             flux_sum = flux_sum.element_by_element(reg.diffuse_coefficient/M_PI);
 
             if (method == NEXT_EVENT_ESTIMATION) flux_sum = flux_sum + direct_light_contributions;
             return flux_sum;
         } else if (event != ABSORPTION) {
-            return integrator_sample_photonmapping(scene, photons, w_i, kernel, method);
+            return integrator_sample_photonmapping(scene, photons, w_i, kernel, method, neighbors);
         } else {
             return {0, 0, 0};
         }
     }
 }
 
+template <typename PhotonMap>
 Vector3d integrator_sample_photonmapping_bvh(const Scene &scene,
                                              const BVH &bvh_tree,
-                                             const nn::KDTree<Photon, 3, PhotonAxisPosition> &photons,
+                                             const PhotonMap &photons,
                                              const Ray ray,
                                              PhotonmappingKernel kernel,
-                                             PhotonmappingDirectLightMethod method) {
+                                             PhotonmappingDirectLightMethod method,
+                                             PhotonNeighbors &neighbors) {
 #ifdef benchmarking
     Benchmarking::count_ray_traced();
 #endif
-    HitRegister reg = bvh_tree.collides(ray);
+    HitRegister reg(bvh_tree.collides(ray));
 
     if (!reg.hits) {
         return {0, 0, 0};
     }
 
-    if (reg.is_area_light) {
-        return reg.emission;
+    const Material &material = surface_at_closest_hit(scene, ray, reg);
+
+    if (material.is_area_light) {
+        return material.emission;
     } else {
-        Event event = russian_roulette(reg);
-        Ray w_i = generate_wi(event, reg, ray);
+        Event event = russian_roulette(reg, material);
+        Ray w_i = generate_wi(event, reg, material, ray);
 
         if (event == DIFFUSE) {
             Vector3d direct_light_contributions = get_contributions_from_direct_lights_bvh(scene, bvh_tree, reg);
 
-            size_t number_of_photons = 25;           // Maximum number of photons to look for
-            //double radius_estimate = 0.1;           // Maximum distance to look for photons
-            auto nearest_neighbors = photons.nearest_neighbors(reg.n.origin.v,
-                                                               number_of_photons,
-                                                               std::numeric_limits<float>::max());
-
-            double max_radio = 0;
-            for (auto photon : nearest_neighbors){
-                max_radio = std::max(max_radio, (reg.n.origin.v - photon->position.v).modulus());
-            }
-
-            Vector3d flux_sum;
-            double d;
-            switch (kernel) {
-                case BOX:
-                    for (auto photon : nearest_neighbors) flux_sum = flux_sum + photon->flux;
-
-                    break;
-
-                case NORMALIZED_BOX:
-                    for (auto photon : nearest_neighbors) flux_sum = flux_sum + photon->flux;
-                    flux_sum = flux_sum / (M_PI * max_radio * max_radio);
-
-                    break;
-
-                case GAUSSIAN:
-                    // Gaussian kernel based on:
-                    //      https://www.researchgate.net/publication/261793571_Overestimation_and_Underestimation_Biases_in_Photon_Mapping_with_Non-Constant_Kernels
-                    for (auto photon : nearest_neighbors) {
-                        d = (reg.n.origin.v - photon->position.v).modulus();
-                        flux_sum = flux_sum + photon->flux*1.728*(1-(1-exp((-1.953*d*d)/(2*max_radio*max_radio)))/(1-exp(-1.953))); // Alpha = 1.728, beta = 1.953
-                    }
-
-                    break;
-
-                case NORMALIZED_GAUSSIAN:
-                    for (auto photon : nearest_neighbors) {
-                        d = (reg.n.origin.v - photon->position.v).modulus();
-                        flux_sum = flux_sum + photon->flux*1.728*(1-(1-exp((-1.953*d*d)/(2*max_radio*max_radio)))/(1-exp(-1.953))); // Alpha = 1.728, beta = 1.953
-                    }
-
-                    flux_sum = flux_sum / (M_PI * max_radio * max_radio);
-
-                    break;
-
-                case CONE:
-                    for (auto photon : nearest_neighbors) {
-                        d = (reg.n.origin.v - photon->position.v).modulus();
-                        flux_sum = flux_sum + photon->flux * (1 - d/(1.1*max_radio)); // Alpha = 1.728, beta = 1.953
-                    }
-
-                    flux_sum = flux_sum / ((1 - 2/(3*1.1))* M_PI * max_radio * max_radio);
-
-                    break;
-            }
-
-            flux_sum = flux_sum.element_by_element(reg.diffuse_coefficient/M_PI);
+            Vector3d flux_sum = photon_map_radiance_bvh(scene, bvh_tree, photons, reg, ray, kernel, method, neighbors);
 
             if (method == NEXT_EVENT_ESTIMATION) flux_sum = flux_sum + direct_light_contributions;
             return flux_sum;
         } else if (event != ABSORPTION) {
-            return integrator_sample_photonmapping_bvh(scene, bvh_tree, photons, w_i, kernel, method);
+            return integrator_sample_photonmapping_bvh(scene, bvh_tree, photons, w_i, kernel, method, neighbors);
         } else {
             return {0, 0, 0};
         }
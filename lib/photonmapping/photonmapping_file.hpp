@@ -0,0 +1,239 @@
+//
+// photonmapping_file.hpp
+//
+// Description:
+//  Photon maps saved to disk, to be reused by later renders of the same scene (i.e. when only the camera, the
+//  kernel or the rays per pixel change). The map only depends on the geometry, the materials and the lights, so
+//  each file is keyed by a hash of them, the scattering budget, the direct light method, the backend and the
+//  compile time options that change the scattering.
+//  Files hold a versioned header followed by the arrays of the built map, aligned, exactly as they are in
+//  memory: loading reads them straight into the vectors of the map, without scattering or building anything
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_PHOTONMAPPING_FILE_HPP
+#define INFORMATICA_GRAFICA_PHOTONMAPPING_FILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include "../Scene.hpp"
+#include "../Photon.hpp"
+#include "SceneHasher.hpp"
+#include "photonmapping.hpp"
+#include "photonmapping_kdtree.hpp"
+#include "photonmapping_hashgrid.hpp"
+
+#define PHOTON_MAP_FILE_VERSION 3
+#define PHOTON_MAP_DIRECTORY "photon_maps"
+
+static_assert(std::is_trivially_copyable_v<Photon>, "Photons are written to disk as they are in memory");
+
+// Hash of everything the photons depend on: the kind, the parameters and the material of every figure, and the point
+// lights. The camera is left out
+uint64_t scene_hash(const Scene &scene) {
+    SceneHasher hasher;
+
+    for (const auto &figure : scene.figures) figure->hash(hasher);
+
+    for (const PointLight &pl : scene.point_lights) {
+        hasher.add(pl.center.v);
+        hasher.add(pl.power);
+    }
+
+    return hasher.value();
+}
+
+struct PhotonMapKey {
+    uint64_t scene_hash = 0;
+    uint64_t walks = 0;
+    uint64_t photons = 0;
+    uint32_t method = 0;
+    uint32_t backend = 0;
+    uint32_t max_bounces = 0;
+    uint32_t emission_towards_scene = 0;
+    double radius = 0; // Of the hash grid gathers
+    double seconds = 0; // Of the scattering, which may stop it before the walks and the photons
+
+    [[nodiscard]] bool operator==(const PhotonMapKey &key) const {
+        return scene_hash == key.scene_hash && walks == key.walks && photons == key.photons &&
+               method == key.method && backend == key.backend && max_bounces == key.max_bounces &&
+               emission_towards_scene == key.emission_towards_scene && radius == key.radius && seconds == key.seconds;
+    }
+
+    [[nodiscard]] std::string file_name() const {
+        SceneHasher hasher;
+        hasher.add(this, sizeof(PhotonMapKey));
+
+        std::ostringstream name;
+        name << PHOTON_MAP_DIRECTORY << "/photon_map_" << std::hex << hasher.value() << ".bin";
+        return name.str();
+    }
+};
+
+PhotonMapKey photon_map_key(const Scene &scene, size_t walks, size_t photons, double seconds,
+                            PhotonmappingDirectLightMethod method, PhotonMapBackend backend) {
+    PhotonMapKey key;
+    key.scene_hash = scene_hash(scene);
+    key.walks = walks;
+    key.photons = photons;
+    key.method = method;
+    key.backend = backend;
+    key.max_bounces = MAX_NUM_OF_BOUNCES;
+    key.emission_towards_scene = PHOTON_EMISSION_TOWARDS_SCENE;
+    key.radius = backend == HASH_GRID ? PHOTONMAP_GATHER_RADIUS : 0;
+    key.seconds = seconds;
+
+    return key;
+}
+
+struct PhotonMapFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t photon_size;
+    PhotonMapKey key;
+
+    // Both arrays start at offsets aligned to 64 bytes. The table holds the nodes of the KD-tree or the buckets of
+    // the hash grid
+    uint64_t number_of_photons, photons_offset;
+    uint64_t table_size, table_element_size, table_offset;
+};
+
+namespace {
+    constexpr char photon_map_magic[8] = {'P', 'H', 'O', 'T', 'O', 'N', 'S', '\0'};
+
+    uint64_t align_to_cache_line(uint64_t offset) {
+        return (offset + 63) & ~uint64_t(63);
+    }
+
+    // Written to a temporary file first, so a render never finds half a map
+    template <typename Table>
+    bool write_photon_map_file(const PhotonMapKey &key, const std::vector<Photon> &photons, const std::vector<Table> &table) {
+        PhotonMapFileHeader header{};
+        std::memcpy(header.magic, photon_map_magic, sizeof(header.magic));
+        header.version = PHOTON_MAP_FILE_VERSION;
+        header.photon_size = sizeof(Photon);
+        header.key = key;
+        header.number_of_photons = photons.size();
+        header.photons_offset = align_to_cache_line(sizeof(PhotonMapFileHeader));
+        header.table_size = table.size();
+        header.table_element_size = sizeof(Table);
+        header.table_offset = align_to_cache_line(header.photons_offset + photons.size() * sizeof(Photon));
+
+        std::error_code error;
+        std::filesystem::create_directories(PHOTON_MAP_DIRECTORY, error);
+
+        std::string file_name = key.file_name(), temporary_name = file_name + ".tmp";
+        std::ofstream file(temporary_name, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+
+        const char padding[64] = {};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(padding, (std::streamsize) (header.photons_offset - sizeof(header)));
+        file.write(reinterpret_cast<const char *>(photons.data()), (std::streamsize) (photons.size() * sizeof(Photon)));
+        file.write(padding, (std::streamsize) (header.table_offset - header.photons_offset - photons.size() * sizeof(Photon)));
+        file.write(reinterpret_cast<const char *>(table.data()), (std::streamsize) (table.size() * sizeof(Table)));
+        file.close();
+
+        if (!file) {
+            std::remove(temporary_name.c_str());
+            return false;
+        }
+
+        return std::rename(temporary_name.c_str(), file_name.c_str()) == 0;
+    }
+
+    // Photon map file, if it exists and was saved with the same key and format
+    class PhotonMapFile {
+        std::ifstream file;
+        uint64_t size = 0;
+
+        template <typename T>
+        bool read(uint64_t offset, uint64_t count, std::vector<T> &out) {
+            out.resize(count);
+            file.seekg((std::streamoff) offset);
+            file.read(reinterpret_cast<char *>(out.data()), (std::streamsize) (count * sizeof(T)));
+            return (bool) file;
+        }
+
+    public:
+        PhotonMapFileHeader header{};
+        bool valid = false;
+
+        PhotonMapFile(const PhotonMapKey &key, size_t table_element_size) :
+                file(key.file_name(), std::ios::binary | std::ios::ate) {
+            if (!file) return;
+
+            size = (uint64_t) file.tellg();
+            if (size < sizeof(PhotonMapFileHeader)) return;
+
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(&header), sizeof(header));
+            valid = file && std::memcmp(header.magic, photon_map_magic, sizeof(header.magic)) == 0 &&
+                    header.version == PHOTON_MAP_FILE_VERSION && header.photon_size == sizeof(Photon) &&
+                    header.key == key && header.table_element_size == table_element_size &&
+                    header.photons_offset + header.number_of_photons * sizeof(Photon) <= size &&
+                    header.table_offset + header.table_size * table_element_size <= size;
+        }
+
+        bool photons(std::vector<Photon> &out) {
+            return read(header.photons_offset, header.number_of_photons, out);
+        }
+
+        template <typename Table>
+        bool table(std::vector<Table> &out) {
+            return read(header.table_offset, header.table_size, out);
+        }
+    };
+}
+
+bool save_photon_map(const PhotonMapKey &key, const PhotonKDTree &photons) {
+    return write_photon_map_file(key, photons.tree_elements(), photons.tree_nodes());
+}
+
+bool save_photon_map(const PhotonMapKey &key, const PhotonHashGrid &photons) {
+    return write_photon_map_file(key, photons.sorted_photons(), photons.buckets());
+}
+
+bool load_photon_map(const PhotonMapKey &key, PhotonKDTree &photons) {
+    PhotonMapFile file(key, sizeof(size_t));
+    if (!file.valid) return false;
+
+    // Photons keep the splitting axes themselves, so there are no nodes
+    if (file.header.table_size != 0 && file.header.table_size != file.header.number_of_photons) return false;
+
+    std::vector<Photon> elements;
+    std::vector<size_t> nodes;
+    if (!file.photons(elements) || !file.table(nodes)) return false;
+
+    photons = PhotonKDTree::built(std::move(elements), std::move(nodes), PhotonAxisPosition());
+    return true;
+}
+
+bool load_photon_map(const PhotonMapKey &key, PhotonHashGrid &photons) {
+    PhotonMapFile file(key, sizeof(uint32_t));
+    if (!file.valid) return false;
+
+    // One more entry than buckets, which are a power of two
+    uint64_t buckets = file.header.table_size - 1;
+    if (file.header.table_size < 2 || (buckets & (buckets - 1)) != 0) return false;
+
+    std::vector<Photon> sorted_photons;
+    std::vector<uint32_t> bucket_start;
+    if (!file.photons(sorted_photons) || !file.table(bucket_start)) return false;
+
+    photons = PhotonHashGrid(std::move(sorted_photons), std::move(bucket_start), key.radius);
+    return true;
+}
+
+#endif //INFORMATICA_GRAFICA_PHOTONMAPPING_FILE_HPP
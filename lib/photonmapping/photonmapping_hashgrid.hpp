@@ -0,0 +1,132 @@
+//
+// photonmapping_hashgrid.hpp
+//
+// Description:
+//  Photon map backed by a uniform grid of cells as wide as the gather radius, hashed into a table with about as
+//  many buckets as photons. The photons are sorted by bucket into a single array, so gathering every photon within
+//  the radius only scans the 3x3x3 cells around the point, without descending any tree
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_PHOTONMAPPING_HASHGRID_HPP
+#define INFORMATICA_GRAFICA_PHOTONMAPPING_HASHGRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../Photon.hpp"
+#include "photonmapping_kdtree.hpp"
+
+using PhotonKDTree = nn::KDTree<Photon, 3, PhotonAxisPosition>;
+
+// Photons found by a gather, with their squared distances, whichever the backend. Each rendering thread keeps one
+// of them, so the photon gathers don't allocate
+using PhotonNeighbors = std::vector<PhotonKDTree::Neighbor>;
+
+class PhotonHashGrid {
+private:
+    std::vector<Photon> photons; // Sorted by bucket
+    std::vector<uint32_t> bucket_start; // Photons of the bucket b are [bucket_start[b], bucket_start[b + 1])
+    size_t bucket_mask = 0;
+
+    double radius = 0;
+    double inverse_cell_size = 0;
+
+    [[nodiscard]] int cell(double x) const {
+        return (int) std::floor(x * inverse_cell_size);
+    }
+
+    [[nodiscard]] size_t bucket(int x, int y, int z) const {
+        return ((uint32_t) x * 73856093u ^ (uint32_t) y * 19349663u ^ (uint32_t) z * 83492791u) & bucket_mask;
+    }
+
+public:
+    PhotonHashGrid() = default;
+
+    PhotonHashGrid(std::vector<Photon> &&_photons, double _radius) : radius(_radius), inverse_cell_size(1 / _radius) {
+        size_t buckets = 1;
+        while (buckets < _photons.size()) buckets <<= 1;
+        bucket_mask = buckets - 1;
+
+        // Counting sort by bucket
+        std::vector<uint32_t> photon_bucket(_photons.size());
+        bucket_start.assign(buckets + 1, 0);
+        for (size_t i = 0; i < _photons.size(); i++) {
+            photon_bucket[i] = bucket(cell(_photons[i][0]), cell(_photons[i][1]), cell(_photons[i][2]));
+            bucket_start[photon_bucket[i] + 1]++;
+        }
+        for (size_t b = 0; b < buckets; b++) bucket_start[b + 1] += bucket_start[b];
+
+        photons.resize(_photons.size());
+        std::vector<uint32_t> next(bucket_start.begin(), bucket_start.end() - 1);
+        for (size_t i = 0; i < _photons.size(); i++) {
+            photons[next[photon_bucket[i]]++] = _photons[i];
+        }
+
+        std::vector<Photon>().swap(_photons);
+    }
+
+    // Restores a grid already built (i.e. saved to a file), with its photons sorted by bucket
+    PhotonHashGrid(std::vector<Photon> &&sorted_photons, std::vector<uint32_t> &&_bucket_start, double _radius) :
+            photons(std::move(sorted_photons)), bucket_start(std::move(_bucket_start)),
+            bucket_mask(bucket_start.empty() ? 0 : bucket_start.size() - 2),
+            radius(_radius), inverse_cell_size(1 / _radius) {}
+
+    // Fills neighbors with every photon closer than the radius to p, in no particular order
+    void gather(const Vector3d &p, PhotonNeighbors &neighbors) const {
+        neighbors.clear();
+        if (photons.empty()) return;
+
+        double radius2 = radius * radius;
+        int x = cell(p[0]), y = cell(p[1]), z = cell(p[2]);
+
+        // Several of the cells could share a bucket, which must only be scanned once
+        size_t visited[27];
+        int number_of_visited = 0;
+        for (int dx = -1; dx <= 1; dx++) for (int dy = -1; dy <= 1; dy++) for (int dz = -1; dz <= 1; dz++) {
+            size_t b = bucket(x + dx, y + dy, z + dz);
+            if (std::find(visited, visited + number_of_visited, b) != visited + number_of_visited) continue;
+            visited[number_of_visited++] = b;
+
+            for (uint32_t i = bucket_start[b]; i < bucket_start[b + 1]; i++) {
+                double d2 = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    double d = p[axis] - photons[i][axis];
+                    d2 += d * d;
+                }
+                if (d2 < radius2) neighbors.push_back({&photons[i], d2});
+            }
+        }
+    }
+
+    [[nodiscard]] double gather_radius() const {
+        return radius;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return photons.size();
+    }
+
+    // Photons sorted by bucket, and where each bucket starts, to save the grid and restore it later
+    [[nodiscard]] const std::vector<Photon> &sorted_photons() const {
+        return photons;
+    }
+
+    [[nodiscard]] const std::vector<uint32_t> &buckets() const {
+        return bucket_start;
+    }
+
+    // Bytes taken by the photons and the table
+    [[nodiscard]] size_t memory() const {
+        return photons.capacity() * sizeof(Photon) + bucket_start.capacity() * sizeof(uint32_t);
+    }
+};
+
+#endif //INFORMATICA_GRAFICA_PHOTONMAPPING_HASHGRID_HPP
@@ -0,0 +1,181 @@
+//
+// photonmapping_irradiance.hpp
+//
+// Description:
+//  Irradiance cache: the irradiance is estimated once around a subset of the photons, right after building the
+//  photon map, so a diffuse hit only needs the nearest of these sites instead of gathering and filtering dozens of
+//  photons. The cache also makes the final gather affordable: each diffuse camera hit shoots a few rays over its
+//  hemisphere and takes the cached irradiance where they land, which hides the blotches of the density estimation
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_PHOTONMAPPING_IRRADIANCE_HPP
+#define INFORMATICA_GRAFICA_PHOTONMAPPING_IRRADIANCE_HPP
+
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "../Scene.hpp"
+#include "pathtracing.hpp"
+#include "../Photon.hpp"
+#include "photonmapping.hpp"
+#include "photonmapping_kdtree.hpp"
+#include "photonmapping_hashgrid.hpp"
+
+#ifdef benchmarking
+#include "benchmarking.hpp"
+#endif
+
+#define IRRADIANCE_CACHE_STRIDE 4     // The irradiance is estimated around one of every so many photons
+#define IRRADIANCE_CACHE_CANDIDATES 4 // Nearest sites looked at to find one on the same side of the surface
+#define FINAL_GATHER_RAYS 16          // Rays shot over the hemisphere of every diffuse camera hit
+
+
+enum PhotonmappingEstimate {
+    DENSITY_ESTIMATION, // Photons gathered at every diffuse hit
+    IRRADIANCE_CACHE,   // Irradiance of the nearest cached site
+    FINAL_GATHER        // Irradiance of the cached sites where the rays of the hemisphere land
+};
+
+// Photons of each backend, in the order they are stored
+inline const std::vector<Photon> &stored_photons(const PhotonKDTree &photons) {
+    return photons.tree_elements();
+}
+
+inline const std::vector<Photon> &stored_photons(const PhotonHashGrid &photons) {
+    return photons.sorted_photons();
+}
+
+class IrradianceCache {
+private:
+    // Photons whose flux is replaced by the irradiance estimated around them. Their incident directions tell the
+    // side of the surface they lie on
+    PhotonKDTree sites;
+    size_t gather_rays = 0;
+
+public:
+    IrradianceCache() = default;
+
+    // Estimates the irradiance around every IRRADIANCE_CACHE_STRIDE-th photon, with the same kernel as the density
+    // estimation, spreading the sites over all the threads
+    template <typename PhotonMap>
+    IrradianceCache(const PhotonMap &photons, PhotonmappingKernel kernel, size_t final_gather_rays) :
+            gather_rays(final_gather_rays) {
+        const std::vector<Photon> &stored = stored_photons(photons);
+        std::vector<Photon> irradiance_sites((stored.size() + IRRADIANCE_CACHE_STRIDE - 1) / IRRADIANCE_CACHE_STRIDE);
+
+        const auto processor_count = std::max(std::thread::hardware_concurrency(), 1u);
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < processor_count; t++) {
+            threads.emplace_back([&, t] {
+                PhotonNeighbors neighbors;
+                size_t first = irradiance_sites.size() * t / processor_count;
+                size_t last = irradiance_sites.size() * (t + 1) / processor_count;
+
+                for (size_t i = first; i < last; i++) {
+                    const Photon &photon = stored[i * IRRADIANCE_CACHE_STRIDE];
+                    double max_radio2 = gather_photons(photons, photon.position().v, neighbors);
+                    irradiance_sites[i] = Photon(photon.position(), photon.indicent_direction(),
+                                                 photon_density_estimation(neighbors, max_radio2, kernel));
+                }
+            });
+        }
+        for (auto &thread : threads) thread.join();
+
+        sites = PhotonKDTree(std::move(irradiance_sites), PhotonAxisPosition());
+    }
+
+    // Irradiance of the nearest site reached from the same side of the surface as the ray, or of the nearest one
+    // if there is none (i.e. next to an edge)
+    Vector3d irradiance(const HitRegister &reg, const Ray &ray, PhotonNeighbors &neighbors) const {
+        sites.nearest_neighbors(reg.n.origin.v, IRRADIANCE_CACHE_CANDIDATES, std::numeric_limits<double>::max(), neighbors);
+
+        double side = ray.direction.v.dot(reg.n.direction.v);
+        const Photon *nearest = nullptr;
+        bool nearest_same_side = false;
+        double nearest_distance = std::numeric_limits<double>::max();
+        for (const auto &neighbor : neighbors) {
+            bool same_side = neighbor.element->indicent_direction().v.dot(reg.n.direction.v) * side > 0;
+            if ((same_side && !nearest_same_side) ||
+                (same_side == nearest_same_side && neighbor.squared_distance < nearest_distance)) {
+                nearest = neighbor.element;
+                nearest_same_side = same_side;
+                nearest_distance = neighbor.squared_distance;
+            }
+        }
+
+        return nearest ? nearest->flux() : Vector3d(0, 0, 0);
+    }
+
+    [[nodiscard]] size_t final_gather_rays() const {
+        return gather_rays;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return sites.size();
+    }
+
+    [[nodiscard]] size_t memory() const {
+        return sites.memory();
+    }
+};
+
+// Radiance arriving along a final gather ray: followed through the specular and refractive bounces, as the camera
+// rays are, up to a diffuse hit, which reflects the cached irradiance (and the direct light, if the photons leave
+// it out)
+Vector3d final_gather_radiance_bvh(const Scene &scene, const BVH &bvh_tree, const IrradianceCache &cache, Ray ray,
+                                   PhotonmappingDirectLightMethod method, PhotonNeighbors &neighbors) {
+    for (size_t number_of_bounces = 0; number_of_bounces <= MAX_NUM_OF_BOUNCES; number_of_bounces++) {
+#ifdef benchmarking
+        Benchmarking::count_ray_traced();
+#endif
+        HitRegister reg(bvh_tree.collides(ray));
+        if (!reg.hits) return {0, 0, 0};
+
+        const Material &material = surface_at_closest_hit(scene, ray, reg);
+        if (material.is_area_light) return material.emission;
+
+        Event event = russian_roulette(reg, material);
+        if (event == DIFFUSE) {
+            Vector3d radiance = cache.irradiance(reg, ray, neighbors).element_by_element(reg.diffuse_coefficient/M_PI);
+            if (method == NEXT_EVENT_ESTIMATION) radiance = radiance + get_contributions_from_direct_lights_bvh(scene, bvh_tree, reg);
+
+            // The roulette only picked the diffuse event with that probability
+            double p_d = std::max(std::max(reg.diffuse_coefficient[0], reg.diffuse_coefficient[1]), reg.diffuse_coefficient[2]);
+            return radiance / p_d;
+        } else if (event == ABSORPTION) {
+            return {0, 0, 0};
+        }
+
+        ray = generate_wi(event, reg, material, ray);
+    }
+
+    return {0, 0, 0};
+}
+
+// Radiance reflected by a diffuse hit from the irradiance cache, looked up at the hit itself or, with the final
+// gather, where the rays of its hemisphere land
+Vector3d photon_map_radiance_bvh(const Scene &scene, const BVH &bvh_tree, const IrradianceCache &cache,
+                                 const HitRegister &reg, const Ray &ray, PhotonmappingKernel /*kernel*/,
+                                 PhotonmappingDirectLightMethod method, PhotonNeighbors &neighbors) {
+    if (cache.final_gather_rays() == 0) {
+        return cache.irradiance(reg, ray, neighbors).element_by_element(reg.diffuse_coefficient/M_PI);
+    }
+
+    // Cosine weighted, so the BRDF and the cosine over the pdf leave the diffuse coefficient
+    Vector3d radiance;
+    for (size_t i = 0; i < cache.final_gather_rays(); i++) {
+        radiance = radiance + final_gather_radiance_bvh(scene, bvh_tree, cache, brdf_sample(reg, ray), method, neighbors);
+    }
+
+    return (radiance / (double) cache.final_gather_rays()).element_by_element(reg.diffuse_coefficient);
+}
+
+#endif //INFORMATICA_GRAFICA_PHOTONMAPPING_IRRADIANCE_HPP
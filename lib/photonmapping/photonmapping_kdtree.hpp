@@ -4,6 +4,9 @@
 #include <array>
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <type_traits>
+#include <thread>
 
 namespace nn {
     
@@ -20,6 +23,11 @@ namespace {
     };
     template <typename> struct is_tuple: std::false_type {};
     template <typename ...T> struct is_tuple<std::tuple<T...>>: std::true_type {};
+    //Whether the axis function can also keep the splitting axis of a node in its element (split_axis(t) and set_split_axis(t,axis))
+    template <typename A, typename T, typename = void> struct stores_split_axis: std::false_type {};
+    template <typename A, typename T> struct stores_split_axis<A, T, std::void_t<
+        decltype(std::declval<const A&>().split_axis(std::declval<const T&>())),
+        decltype(std::declval<const A&>().set_split_axis(std::declval<T&>(), std::size_t(0)))>>: std::true_type {};
 };
     
 /**
@@ -28,17 +36,27 @@ namespace {
  * A - Axis function to the position
             A axis_position; T t;
             axis_position(t,d) returns the numerical position for the d dimension. If possible it is deduced automatically for random access vectors and the like.
+            If it also has split_axis(t) and set_split_axis(t,axis), the splitting axis of each node is kept in its element instead of in a separate vector.
 **/
 template<typename T, std::size_t N, typename A>
 class KDTree {
 public:
     using real = decltype(std::declval<A>()(std::declval<T>(),std::size_t(0)));
     static constexpr std::size_t dimensions = N;
+
+    //Result of the allocation free queries: an element and its squared euclidean distance to the query point
+    struct Neighbor {
+        const T* element;
+        real squared_distance;
+
+        bool operator<(const Neighbor& other) const { return squared_distance < other.squared_distance; }
+    };
    
 private:
     A axis_position;
     using axis_type = std::size_t; //The axis type is std::size_t but we might want to reduce its size in compile time when N<256...
     //elements and nodes are sorted equally so the element pointed by the ith node in node is the ith element in elements 
+    //(nodes is empty if the elements keep their own splitting axis)
     std::vector<axis_type> nodes;
     std::vector<T> elements;
     //Given a node / element in position $i$, its left child is in position 2i+1 and its right child 2i+2
@@ -69,15 +87,56 @@ private:
         return sol;
     }
     
-    void build_tree(std::size_t left, std::size_t right) {
+    std::size_t split_axis(std::size_t i) const {
+        if constexpr (stores_split_axis<A,T>::value) return axis_position.split_axis(elements[i]);
+        else return nodes[i];
+    }
+
+    void set_split_axis(std::size_t i, std::size_t axis) {
+        if constexpr (stores_split_axis<A,T>::value) axis_position.set_split_axis(elements[i],axis);
+        else nodes[i] = axis;
+    }
+
+    //Below this number of elements, a subtree (or a bounding box) isn't worth a thread of its own
+    static constexpr std::size_t parallel_grain = std::size_t(1) << 14;
+
+    void bounding_box(std::size_t left, std::size_t right, std::array<real,N>& bbmin, std::array<real,N>& bbmax) const {
+        assign(bbmin,elements[left]); assign(bbmax,elements[left]);
+        for (std::size_t i = (left+1); i < right; ++i) {
+            if_less_assign(bbmin,elements[i]);
+            if_greater_assign(bbmax,elements[i]);
+        }
+    }
+
+    //Same bounding box, each of the tasks threads reducing a chunk of the range (the top levels of the tree are the most expensive ones)
+    void bounding_box(std::size_t left, std::size_t right, std::size_t tasks, std::array<real,N>& bbmin, std::array<real,N>& bbmax) const {
+        tasks = std::min(tasks, (right-left)/parallel_grain);
+        if (tasks <= 1) { bounding_box(left,right,bbmin,bbmax); return; }
+
+        std::vector<std::array<real,N>> chunk_min(tasks), chunk_max(tasks);
+        std::vector<std::thread> threads;
+        for (std::size_t t = 1; t < tasks; ++t) {
+            threads.emplace_back([&, t] {
+                bounding_box(left+(right-left)*t/tasks, left+(right-left)*(t+1)/tasks, chunk_min[t], chunk_max[t]);
+            });
+        }
+        bounding_box(left, left+(right-left)/tasks, chunk_min[0], chunk_max[0]);
+        for (auto& thread : threads) thread.join();
+
+        bbmin = chunk_min[0]; bbmax = chunk_max[0];
+        for (std::size_t t = 1; t < tasks; ++t) for (std::size_t i = 0; i<N; ++i) {
+            bbmin[i] = std::min(bbmin[i],chunk_min[t][i]);
+            bbmax[i] = std::max(bbmax[i],chunk_max[t][i]);
+        }
+    }
+
+    //tasks is the number of threads available for this subtree: both halves of the top levels are built in parallel,
+    //splitting them. Subtrees only touch their own range of elements and nodes, so the tree is the same as the serial one
+    void build_tree(std::size_t left, std::size_t right, std::size_t tasks) {
         if ((right-left) > 1) {
             //We build the bounding box each subdivision because even if it is slow it leaves a better kdtree balance
             std::array<real,N> bbmin, bbmax;
-            assign(bbmin,elements[left]); assign(bbmax,elements[left]);
-            for (std::size_t i = (left+1); i < right; ++i) {
-                if_less_assign(bbmin,elements[i]);
-                if_greater_assign(bbmax,elements[i]);
-            }
+            bounding_box(left,right,tasks,bbmin,bbmax);
             std::size_t median = (right+left)/2;
             //We find the larger axis
             std::size_t axis = 0; real max_bound = bbmax[0]-bbmin[0];
@@ -89,16 +148,22 @@ private:
                 [&] (const T& a, const T& b) { return axis_position(a,axis)<axis_position(b,axis); });
             //The median stays in the median, so if in one dimension the vector is ordered (but not the case)
             //We setup the node as well (we just need the axis)
-            nodes[median] = axis;
+            set_split_axis(median,axis);
             //Recursive calls for the subtrees.
-            build_tree(left,median);
-            build_tree(median+1,right);
+            if (tasks > 1 && (right-left) > parallel_grain) {
+                std::thread left_subtree([&] { build_tree(left,median,tasks/2); });
+                build_tree(median+1,right,tasks-tasks/2);
+                left_subtree.join();
+            } else {
+                build_tree(left,median,1);
+                build_tree(median+1,right,1);
+            }
         }
     }
 
     void build_tree() {
-        nodes.resize(elements.size());
-        build_tree(0,elements.size());
+        if constexpr (!stores_split_axis<A,T>::value) nodes.resize(elements.size());
+        build_tree(0,elements.size(),std::max(std::thread::hardware_concurrency(),1u));
     }
 
     template<typename Norm> //Norm is a norm of a vector (euclidean or any other one, even a weighted one) for std::array<real,N>
@@ -120,9 +185,10 @@ private:
             //We have to explore the children, so we choose according to the node
             if ((right-left)>1) {
                 //This is for distance measurement to check if we need to explore the other node
+                std::size_t axis = split_axis(median);
                 std::array<real,N> pplane = p;
-                pplane[nodes[median]] = axis_position(elements[median],nodes[median]);
-                if (p[nodes[median]] < axis_position(elements[median],nodes[median])) {//First left node and then, if needed, right node
+                pplane[axis] = axis_position(elements[median],axis);
+                if (p[axis] < axis_position(elements[median],axis)) {//First left node and then, if needed, right node
                     nearest_neighbors_impl(values,left,median,p,number,max_distance,norm);
                     if (norm(difference(p,pplane)) < max_distance) //We still need to explore the other node
                         nearest_neighbors_impl(values,median+1,right,p,number,max_distance,norm);
@@ -135,12 +201,81 @@ private:
         }
     }
 
+    real squared_distance(const std::array<real,N>& p, const T& t) const {
+        real s(0);
+        for (std::size_t i = 0; i<N; ++i) { real d = p[i] - axis_position(t,i); s += d*d; }
+        return s;
+    }
+
+    //Same search as nearest_neighbors_impl, with euclidean distances but only comparing their squares. neighbors is a max heap
+    //once it has number elements, and max_distance2 shrinks to its farthest one from then on
+    void nearest_neighbors_squared_impl(std::vector<Neighbor>& neighbors, std::size_t left, std::size_t right, const std::array<real,N>& p, std::size_t number, real& max_distance2) const {
+        if (right > left) {
+            std::size_t median = (right+left)/2; //Points to the actual node which is always in the median
+            real d2 = squared_distance(p,elements[median]);
+            if (d2 < max_distance2) {
+                if (neighbors.size() < number) {
+                    neighbors.push_back(Neighbor{&elements[median],d2});
+                    if (neighbors.size() == number) { //We reach the number so we make this a heap
+                        std::make_heap(neighbors.begin(),neighbors.end());
+                        max_distance2 = neighbors.front().squared_distance;
+                    }
+                } else { //The farthest one is replaced
+                    std::pop_heap(neighbors.begin(),neighbors.end());
+                    neighbors.back() = Neighbor{&elements[median],d2};
+                    std::push_heap(neighbors.begin(),neighbors.end());
+                    max_distance2 = neighbors.front().squared_distance;
+                }
+            }
+            if ((right-left)>1) {
+                std::size_t axis = split_axis(median);
+                real plane_distance = p[axis] - axis_position(elements[median],axis);
+                if (plane_distance < 0) {//First left node and then, if needed, right node
+                    nearest_neighbors_squared_impl(neighbors,left,median,p,number,max_distance2);
+                    if (plane_distance*plane_distance < max_distance2)
+                        nearest_neighbors_squared_impl(neighbors,median+1,right,p,number,max_distance2);
+                } else { //First right node and then, if needed, left node
+                    nearest_neighbors_squared_impl(neighbors,median+1,right,p,number,max_distance2);
+                    if (plane_distance*plane_distance < max_distance2)
+                        nearest_neighbors_squared_impl(neighbors,left,median,p,number,max_distance2);
+                }
+            }
+        }
+    }
+
 public:
-    KDTree(std::vector<T>&& elements, const A& axis_position = A()) : elements(std::move(elements)), axis_position(axis_position) { build_tree(); }
+    KDTree(std::vector<T>&& elements, const A& axis_position = A()) : axis_position(axis_position), elements(std::move(elements)) { build_tree(); }
     KDTree() {}
+    //Restores a tree already built (i.e. saved to a file), with its elements and nodes in tree order
+    static KDTree built(std::vector<T>&& elements, std::vector<std::size_t>&& nodes, const A& axis_position = A()) {
+        KDTree tree;
+        tree.elements = std::move(elements); tree.nodes = std::move(nodes); tree.axis_position = axis_position;
+        return tree;
+    }
     template<typename C> //Constructing from a general collection if possible
     KDTree(const C& c, const A& axis_position = A(), typename std::enable_if<std::is_same<T,typename C::value_type>::value>::type* sfinae = nullptr) : axis_position(axis_position), elements(c.begin(),c.end()) { build_tree(); }
 
+    std::size_t size() const { return elements.size(); }
+
+    //Elements and nodes in tree order, to save the tree and restore it later with built()
+    const std::vector<T>& tree_elements() const { return elements; }
+    const std::vector<std::size_t>& tree_nodes() const { return nodes; }
+
+    //Bytes taken by the elements and the nodes
+    std::size_t memory() const { return elements.capacity()*sizeof(T) + nodes.capacity()*sizeof(axis_type); }
+
+    //Fills neighbors with the (up to) number nearest elements closer than max_distance to p, in no particular order. The caller
+    //keeps the buffer between queries, so they don't allocate once it has room for number elements
+    template<typename P> //P -> position N dimensional, should have random access
+    void nearest_neighbors(const P& p, std::size_t number, real max_distance, std::vector<Neighbor>& neighbors) const {
+        std::array<real,N> p_impl;
+        for (std::size_t i = 0; i<N; ++i) p_impl[i] = p[i];
+        neighbors.clear();
+        neighbors.reserve(number);
+        real max_distance2 = (max_distance < std::numeric_limits<real>::max()) ? max_distance*max_distance : std::numeric_limits<real>::infinity();
+        nearest_neighbors_squared_impl(neighbors,0,elements.size(),p_impl,number,max_distance2);
+    }
+
     template<typename Norm>
     std::vector<const T*> nearest_neighbors(const std::array<real,N>& p, std::size_t number, float max_distance, const Norm& norm) const {
         std::vector<const T*> sol;
@@ -57,7 +57,7 @@ public:
         double max = 0.0;
 
         for (auto v : ppm.img) {
-            max = std::max(max, v[2]);
+            max = std::max<double>(max, v[2]);
         }
 
         for (auto v : ppm.img) {
@@ -140,13 +140,13 @@ private:
         v = max;
         auto delta = max - min;
         if (delta < 0.00001) {
-            return {0, 0, v};
+            return Vector3d(0, 0, v);
         }
 
         if ( max > 0.0 ) {
             s = (delta / max);
         } else {
-            return {NAN, 0, v};
+            return Vector3d(NAN, 0, v);
         }
         if (rgb[0] >= max)
             h = ( rgb[1] - rgb[2] ) / delta;
@@ -161,7 +161,7 @@ private:
         if( h < 0.0 )
             h += 360.0;
 
-        return {h*M_PI/180, s, v};
+        return Vector3d(h*M_PI/180, s, v);
     }
 
     // Based on:
@@ -175,7 +175,7 @@ private:
             r = hsv[2];
             g = hsv[2];
             b = hsv[2];
-            return {r, g, b};
+            return Vector3d(r, g, b);
         }
         hh = hsv[0];
         if(hh >= 360.0*M_PI/180) hh = 0.0;
@@ -221,7 +221,7 @@ private:
                 break;
         }
 
-        return {r, g, b};
+        return Vector3d(r, g, b);
     }
 };
 
@@ -5,6 +5,9 @@
 #include "pathtracer/multithreaded_pathtracer_bvh.hpp"
 #include "photonmapper/multithreaded_photonmapper.hpp"
 #include "photonmapper/multithreaded_photonmapper_bvh.hpp"
+#include "photonmapper/multithreaded_sppm_bvh.hpp"
+#include "benchmarks/triangle_packets_benchmark.hpp"
+#include "benchmarks/image_difference.hpp"
 
 using namespace std;
 
@@ -26,8 +29,21 @@ int main() {
      *                                                                                                                      *
      *   - Maximum number of photons: MAX_PHOTONS in multithreaded_photonmapper.hpp and multithreaded_photonmapper_bvh.hpp  *
      *                                                                                                                      *
-     *   - Number of photons to take from the map: number_of_photons variable in the integrator_sample_photonmapping        *
-     *     and integrator_sample_photonmapping_bvh functions, in photonmapping.hpp                                          *
+     *   - Number of photons to take from the KD-tree: PHOTONMAP_NEAREST_PHOTONS in photonmapping.hpp                       *
+     *                                                                                                                      *
+     *   - Radius of the gathers from the hash grid: PHOTONMAP_GATHER_RADIUS in photonmapping.hpp                           *
+     *                                                                                                                      *
+     *   - Only emit towards the scene from lights outside of it: PHOTON_EMISSION_TOWARDS_SCENE in photonmapping.hpp        *
+     *                                                                                                                      *
+     *   - Irradiance cache: one site every IRRADIANCE_CACHE_STRIDE photons, and FINAL_GATHER_RAYS per diffuse hit,         *
+     *     in photonmapping_irradiance.hpp                                                                                  *
+     *                                                                                                                      *
+     *   - Directory of the photon maps saved for reuse: PHOTON_MAP_DIRECTORY in photonmapping_file.hpp                     *
+     *                                                                                                                      *
+     *  Progressive photonmapper (in multithreaded_sppm_bvh.hpp):                                                           *
+     *   - Number of passes: SPPM_ITERATIONS, and walks per pass: SPPM_WALKS_PER_PASS                                       *
+     *                                                                                                                      *
+     *   - Initial gather radius: SPPM_INITIAL_RADIUS, and how fast it shrinks: SPPM_ALPHA                                  *
      *                                                                                                                      *
      ************************************************************************************************************************/
 
@@ -79,6 +95,20 @@ int main() {
     // Contest scene (Lots of OBJs + textures + Constructive solid geometry + complex camera stuff)
     //Scene scene = Scene::cornell_box_twin_peaks(width, height, rays_per_pixel);
 
+    // Simplifies the meshes to the detail needed by their size on screen (or to a number of triangles, i.e.
+    // simplify_mesh(*mesh, 100000) right after load_obj in the scene)
+    //scene.simplify_meshes(); // Triangles per covered pixel, LOD_TRIANGLES_PER_PIXEL by default
+
+    // Ray-triangle intersection kernel (WATERTIGHT by default)
+    //triangle_intersection_method = MOLLER_TRUMBORE; // MOLLER_TRUMBORE, WATERTIGHT
+
+    // Ray-triangle kernels micro-benchmark (scalar vs. SIMD packets), exits without rendering
+    //benchmark_triangle_packets(); return 0;
+
+    // Compares a render with a previous one (i.e. the single precision build, -DSINGLE_PRECISION=ON, against
+    // the double precision one), exits without rendering
+    //image_difference("render_hdr_double.ppm", "render_hdr.ppm"); return 0;
+
     /*******************************************
      * Available algorithms, uncomment all the *
      * lines below their respective comments   *
@@ -94,11 +124,20 @@ int main() {
     // Photonmapping (without BVH)
     //PhotonmappingDirectLightMethod method = STORE_ALL_PHOTONS; // NEXT_EVENT_ESTIMATION, STORE_ALL_PHOTONS
     //PhotonmappingKernel kernel = CONE; // CONE, BOX, NORMALIZED_BOX, GAUSSIAN, NORMALIZED_GAUSSIAN
-    //render_multithreaded_photonmapper(scene, kernel, method);
+    //PhotonMapBackend backend = KD_TREE; // KD_TREE (nearest photons), HASH_GRID (photons within a fixed radius)
+    //bool reuse_photon_map = false; // Saves the photon map, or loads it if already saved for the same scene and settings
+    //render_multithreaded_photonmapper(scene, kernel, method, backend, reuse_photon_map);
 
     // Photonmapping  (with BVH)
     //PhotonmappingDirectLightMethod method = NEXT_EVENT_ESTIMATION; // NEXT_EVENT_ESTIMATION, STORE_ALL_PHOTONS
     //PhotonmappingKernel kernel = NORMALIZED_GAUSSIAN; // CONE, BOX, NORMALIZED_BOX, GAUSSIAN, NORMALIZED_GAUSSIAN
     //BvhMethod bvh_method = CENTROID; // CENTROID, SORT (CENTROID produces better hierarchies)
-    //render_multithreaded_photonmapper_bvh(scene, kernel, method, bvh_method);
+    //PhotonMapBackend backend = KD_TREE; // KD_TREE (nearest photons), HASH_GRID (photons within a fixed radius)
+    //bool reuse_photon_map = false; // Saves the photon map, or loads it if already saved for the same scene and settings
+    //PhotonmappingEstimate estimate = DENSITY_ESTIMATION; // DENSITY_ESTIMATION, IRRADIANCE_CACHE, FINAL_GATHER
+    //render_multithreaded_photonmapper_bvh(scene, kernel, method, bvh_method, backend, reuse_photon_map, estimate);
+
+    // Stochastic progressive photon mapping (with BVH), for caustics at any number of photons
+    //BvhMethod bvh_method = CENTROID; // CENTROID, SORT (CENTROID produces better hierarchies)
+    //render_multithreaded_sppm_bvh(scene, bvh_method); // Number of passes, SPPM_ITERATIONS by default
 }
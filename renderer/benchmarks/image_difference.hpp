@@ -0,0 +1,64 @@
+//
+// image_difference.hpp
+//
+// Description:
+//  Compares two renders of the same scene, i.e. the double and the single precision builds (see Real.hpp).
+//  Pathtracing is noisy, so both should be rendered with enough rays per pixel for the noise to stay below
+//  the tolerance
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_IMAGE_DIFFERENCE_HPP
+#define INFORMATICA_GRAFICA_IMAGE_DIFFERENCE_HPP
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include "../lib/Ppm.hpp"
+
+// Prints the difference between both images (i.e. two render_hdr.ppm). They are considered equal if their RMSE,
+// relative to the mean value of the reference, is below the tolerance
+bool image_difference(const std::string &reference_file, const std::string &image_file, double tolerance = 0.05) {
+    Ppm reference, image;
+    reference.read(reference_file);
+    image.read(image_file);
+
+    if (reference.width != image.width || reference.height != image.height || reference.img.size() != image.img.size()) {
+        std::cout << "Images of different sizes: " << reference.width << "x" << reference.height << " and "
+                  << image.width << "x" << image.height << std::endl;
+        return false;
+    }
+
+    double reference_mean = 0, image_mean = 0, squared_error = 0, max_error = 0;
+    for (size_t i = 0; i < reference.img.size(); i++) {
+        for (int c = 0; c < 3; c++) {
+            double error = reference.img[i][c] - image.img[i][c];
+            reference_mean += reference.img[i][c];
+            image_mean += image.img[i][c];
+            squared_error += error * error;
+            max_error = std::max(max_error, std::abs(error));
+        }
+    }
+
+    double samples = 3.0 * (double) reference.img.size();
+    reference_mean /= samples;
+    image_mean /= samples;
+    double relative_rmse = reference_mean > 0 ? std::sqrt(squared_error / samples) / reference_mean : 0;
+
+    std::cout << "Mean value: " << reference_mean << " (" << reference_file << "), " << image_mean << " ("
+              << image_file << ")" << std::endl;
+    std::cout << "Relative RMSE: " << relative_rmse << ", max. difference: " << max_error << std::endl;
+
+    bool equal = relative_rmse <= tolerance;
+    std::cout << (equal ? "Images match" : "Images differ") << " (tolerance " << tolerance << ")" << std::endl;
+
+    return equal;
+}
+
+#endif //INFORMATICA_GRAFICA_IMAGE_DIFFERENCE_HPP
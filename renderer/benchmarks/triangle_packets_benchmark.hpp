@@ -0,0 +1,105 @@
+//
+// triangle_packets_benchmark.hpp
+//
+// Description:
+//  Micro-benchmark of the ray-triangle kernels: the scalar Triangle::collides against TrianglePacket,
+//  for both Möller–Trumbore and watertight intersection
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_TRIANGLE_PACKETS_BENCHMARK_HPP
+#define INFORMATICA_GRAFICA_TRIANGLE_PACKETS_BENCHMARK_HPP
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Triangle.hpp"
+#include "TrianglePacket.hpp"
+
+// Casts every ray against all the triangles (small and randomly placed inside [-1, 1]^3), keeping the closest hit
+void benchmark_triangle_packets(size_t number_of_triangles = 4096, size_t number_of_rays = 4096) {
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<double> cube(-1, 1);
+    auto random_point = [&]() { return Vector3d(cube(gen), cube(gen), cube(gen)); };
+
+    std::vector<Triangle> triangles;
+    std::vector<TrianglePacket> packets;
+    for (size_t i = 0; i < number_of_triangles; i++) {
+        Vector3d center = random_point();
+        Vector3d a = center + 0.1 * random_point(), b = center + 0.1 * random_point(), c = center + 0.1 * random_point();
+
+        triangles.emplace_back(Point(a), Point(b), Point(c), Vector3d(0.5, 0.5, 0.5), Vector3d(), Vector3d(), 1);
+        if (packets.empty() || packets.back().full()) packets.emplace_back();
+        packets.back().add(a, b, c, (uint32_t) i);
+    }
+
+    std::vector<Ray> rays;
+    for (size_t i = 0; i < number_of_rays; i++) {
+        Vector3d origin = 3 * random_point().normalize();
+        rays.emplace_back(Point(origin), Direction(random_point() - origin));
+    }
+
+    TriangleIntersectionMethod previous_method = triangle_intersection_method;
+    double tests = (double) number_of_triangles * (double) number_of_rays;
+
+    for (auto method : {MOLLER_TRUMBORE, WATERTIGHT}) {
+        triangle_intersection_method = method;
+        std::cout << (method == MOLLER_TRUMBORE ? "Möller–Trumbore" : "Watertight") << ":" << std::endl;
+
+        // Scalar
+        size_t hits = 0;
+        double t_sum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto &ray : rays) {
+            TraversalHit closest;
+            for (const auto &triangle : triangles) {
+                TraversalHit temp = triangle.collides(ray);
+                if (temp.hits && (!closest.hits || temp.t < closest.t)) closest = temp;
+            }
+            if (closest.hits) {
+                hits++;
+                t_sum += closest.t;
+            }
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        std::cout << "\tScalar:  " << ns / tests << " ns per ray-triangle test ("
+                  << hits << " hits, t sum " << t_sum << ")" << std::endl;
+
+        // Packets of TRIANGLE_PACKET_WIDTH triangles
+        hits = 0;
+        t_sum = 0;
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto &ray : rays) {
+            bool found = false;
+            double closest_t = 0;
+            for (const auto &packet : packets) {
+                double t, u, v;
+                if (triangle_packet_collides(packet, ray, t, u, v) >= 0 && (!found || t < closest_t)) {
+                    found = true;
+                    closest_t = t;
+                }
+            }
+            if (found) {
+                hits++;
+                t_sum += closest_t;
+            }
+        }
+        end = std::chrono::high_resolution_clock::now();
+        ns = std::chrono::duration<double, std::nano>(end - start).count();
+        std::cout << "\tPackets: " << ns / tests << " ns per ray-triangle test ("
+                  << hits << " hits, t sum " << t_sum << ")" << std::endl;
+    }
+
+    triangle_intersection_method = previous_method;
+}
+
+#endif //INFORMATICA_GRAFICA_TRIANGLE_PACKETS_BENCHMARK_HPP
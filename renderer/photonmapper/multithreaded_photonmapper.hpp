@@ -15,6 +15,8 @@
 #ifndef INFORMATICA_GRAFICA_PHOTONMAPPER_RENDERER_HPP
 #define INFORMATICA_GRAFICA_PHOTONMAPPER_RENDERER_HPP
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include "camera.hpp"
 #include "Figure.hpp"
@@ -28,7 +30,9 @@
 #include "../../lib/Photon.hpp"
 #include "../../photonmapping/photonmapping.hpp"
 #include "../../photonmapping/photonmapping_kdtree.hpp"
-#include "ThreadSafeCounter.hpp"
+#include "../../photonmapping/photonmapping_hashgrid.hpp"
+#include "../../photonmapping/photonmapping_file.hpp"
+#include "../../photonmapping/photonmapping_irradiance.hpp"
 
 #ifdef benchmarking
 #include "benchmarking.hpp"
@@ -37,116 +41,188 @@
 
 #define MAX_WALKS 750000
 #define MAX_PHOTONS 100000
+#define MAX_SCATTERING_SECONDS 0 // Time budget for the photon scattering, no limit if 0
 
 /*
  *
  * Photon scattering
  *
  */
-struct RenderingMessagePhotonScattering {
-    bool stop = false;
-    Ray ray;
-    std::shared_ptr<ThreadSafeCounter> photons_stored;
+// Limits of the photon scattering: whichever is reached first stops every thread
+struct PhotonScatteringBudget {
+    size_t walks;
+    size_t photons;
+    double seconds; // No limit if 0
 };
 
-std::vector<Photon> rendering_job_photonmapper(const Scene &scene, const Ray &ray, PhotonmappingDirectLightMethod method) {
-    std::vector<Photon> photons;
-    scatter_photons(scene, ray, 0, photons, Vector3d(1, 1, 1), method);
-
-    return photons;
-}
-
-void rendering_thread_photonmapper(const Scene &scene, Channel<RenderingMessagePhotonScattering> &job_channel, Channel<std::vector<Photon>> &job_done_channel, PhotonmappingDirectLightMethod method) {
+// Traces the walks of this thread into its own buffer. Each walk reserves room for its photons in the global
+// budget with a single atomic addition; the walk which reaches the budget is still kept whole. Once any budget is
+// exhausted, the rest of the walks of the thread are never emitted
+template <typename PhotonTracer>
+void rendering_thread_photonmapper(const Scene &scene, const Bounds3d &bounds, const PhotonScatteringBudget &budget,
+                                   std::chrono::steady_clock::time_point deadline, size_t thread, size_t threads,
+                                   std::atomic<size_t> &photons_stored, std::vector<Photon> &photons,
+                                   size_t &walks, PhotonTracer trace) {
+    PhotonMapperRayGenerator generator(scene.point_lights, budget.walks, thread, threads, bounds);
+
+    size_t traced_walks = 0;
     while(true) {
-        RenderingMessagePhotonScattering job = job_channel.receive();
+        auto tuple = generator.generate_ray();
+        if (!tuple.second) break;
 
-        if (job.stop) {
-            break;
-        } else {
-            if (job.photons_stored->get() < MAX_PHOTONS) {
-                auto photons = rendering_job_photonmapper(scene, job.ray, method);
-                job.photons_stored->increment(photons.size());
-                job_done_channel.send(std::move(photons));
-            } else {
-                job_done_channel.send(std::vector<Photon>());
-            }
-        }
+        size_t walk_start = photons.size();
+        trace(tuple.first, photons);
+        traced_walks++;
+
+        // Also tells whether the other threads exhausted the budget, even if this walk stored nothing
+        size_t walk_photons = photons.size() - walk_start;
+        if (photons_stored.fetch_add(walk_photons, std::memory_order_relaxed) + walk_photons >= budget.photons) break;
+        if (budget.seconds > 0 && std::chrono::steady_clock::now() >= deadline) break;
     }
+
+    walks = traced_walks;
 }
 
-void stop_rendering_jobs_photonmapper(std::chrono::high_resolution_clock::time_point &timer,
-                                      Channel<RenderingMessagePhotonScattering> &job_channel, std::vector<std::thread> &threads,
-                                      const unsigned int processor_count) { // Parar threads
+// Scatters photons until the budget is exhausted, with trace(ray, photons) following each walk. Every thread
+// generates its own rays and stores its photons in its own buffer, so they never wait for each other. The buffers
+// are only concatenated once, to be moved into the photon map. The bounds of the scene (which the BVH renderers take
+// from the tree, once the figures are gone) aim the lights outside of it. Progressive renderers scatter many times,
+// quietly
+template <typename PhotonTracer>
+std::vector<Photon> multithreaded_photon_scattering(const Scene &scene, const Bounds3d &bounds,
+                                                    const PhotonScatteringBudget &budget, PhotonTracer trace,
+                                                    bool verbose = true) {
+    auto timer = empezar_timer();
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget.seconds));
+
+    const auto processor_count = std::max(std::thread::hardware_concurrency(), 1u);
+    std::atomic<size_t> photons_stored{0};
+    std::vector<std::vector<Photon>> buffers(processor_count);
+    std::vector<size_t> walks(processor_count, 0);
+
+    std::vector<std::thread> threads;
     for (size_t i = 0; i < processor_count; i++) {
-        job_channel.send(RenderingMessagePhotonScattering{true, Ray(), nullptr});
+        buffers[i].reserve(std::min(budget.photons, budget.walks) / processor_count);
+        threads.emplace_back(std::thread(rendering_thread_photonmapper<PhotonTracer>, std::ref(scene),
+                                         std::ref(bounds), std::ref(budget), deadline, i, (size_t) processor_count,
+                                         std::ref(photons_stored), std::ref(buffers[i]), std::ref(walks[i]), trace));
+    }
+    if (verbose) {
+        std::cout << processor_count << " photon scattering threads started..." << std::endl;
+        std::cout << "Scattering photons..." << std::endl;
     }
 
     for (size_t i = 0; i < processor_count; i++) {
         threads[i].join();
     }
 
-    std::cout << "Photon scattering total time: " << time_elapsed(timer) << std::endl;
+    if (verbose) {
+        std::cout << "Photon scattering total time: " << time_elapsed(timer) << std::endl;
 #ifdef benchmarking
-    Benchmarking::print_statistics();
+        Benchmarking::print_statistics();
 #endif
-}
+    }
+
+    size_t number_of_photons = 0, number_of_walks = 0;
+    for (size_t i = 0; i < processor_count; i++) {
+        number_of_photons += buffers[i].size();
+        number_of_walks += walks[i];
+    }
 
-std::pair<std::vector<Photon>, int> track_rendering_jobs_photonmapper(Channel<std::vector<Photon>> &job_done_channel) {
-    std::vector<Photon> all_photons;
-    all_photons.reserve(MAX_PHOTONS);
+    std::vector<Photon> all_photons = std::move(buffers[0]);
+    all_photons.reserve(number_of_photons);
+    for (size_t i = 1; i < processor_count; i++) {
+        all_photons.insert(all_photons.end(), std::make_move_iterator(buffers[i].begin()),
+                           std::make_move_iterator(buffers[i].end()));
+        std::vector<Photon>().swap(buffers[i]);
+    }
 
-    int walks = 0;
+    if (verbose) {
+        std::cout << "Scattered photons: " << all_photons.size() << std::endl;
+        std::cout << "Number of walks: " << number_of_walks << "/" << budget.walks << std::endl << std::endl;
+    }
 
-    std::cout << "Scattering photons..." << std::endl;
-    for (size_t i = 0; i < MAX_WALKS; i++) {
-        std::vector<Photon> received_vec = job_done_channel.receive();
-        if (received_vec.empty()) ++walks;
-        all_photons.insert(all_photons.end(), received_vec.begin(), received_vec.end());
+    // Each walk carries the whole power of its light (over the probability of choosing it), so the photons are
+    // normalized by the walks actually emitted, wherever the scattering stopped
+    if (number_of_walks > 0) {
+        for (Photon &photon : all_photons) {
+            photon.scale_flux(4*M_PI / number_of_walks);
+        }
     }
 
-    return std::make_pair(all_photons, walks);
+    return all_photons;
 }
 
-void send_rendering_jobs_photonmapper(const Scene &scene, Channel<RenderingMessagePhotonScattering> &job_channel, const std::shared_ptr<ThreadSafeCounter> &photons_stored) {
-    PhotonMapperRayGenerator f(scene.point_lights, MAX_WALKS);
+std::vector<Photon> multithreaded_photon_scattering(const Scene &scene, PhotonmappingDirectLightMethod method) {
+    return multithreaded_photon_scattering(scene, scene_bounds(scene), {MAX_WALKS, MAX_PHOTONS, MAX_SCATTERING_SECONDS},
+                                           [&scene, method](const Ray &ray, std::vector<Photon> &photons) {
+        scatter_photons(scene, ray, 0, photons, Vector3d(1, 1, 1), method);
+    });
+}
 
-    while(true) {
-        auto tuple = f.generate_ray();
 
-        if (!tuple.second)  break;
-        else {
-            job_channel.send(RenderingMessagePhotonScattering{false, tuple.first, photons_stored});
-        }
-    }
+/*
+ *
+ * Photon map
+ *
+ */
+template <typename PhotonMap>
+void print_photon_map_statistics(const std::string &name, std::chrono::high_resolution_clock::time_point &timer,
+                                 const PhotonMap &photons) {
+    std::cout << name << " built in: " << time_elapsed(timer) << std::endl;
+    std::cout << "Photon map memory: " << photons.memory() / (1024.0 * 1024.0) << " MB ("
+              << (photons.size() > 0 ? photons.memory() / photons.size() : 0) << " bytes per photon)" << std::endl << std::endl;
 }
 
-nn::KDTree<Photon, 3, PhotonAxisPosition> multithreaded_photon_scattering(const Scene &scene, PhotonmappingDirectLightMethod method) {
-    std::shared_ptr<ThreadSafeCounter> photons_stored = std::make_shared<ThreadSafeCounter>();
+PhotonKDTree build_photon_kdtree(std::vector<Photon> &&photons) {
+    auto timer = empezar_timer();
+    PhotonKDTree kdtree(std::move(photons), PhotonAxisPosition());
+    print_photon_map_statistics("KD-tree", timer, kdtree);
 
+    return kdtree;
+}
+
+PhotonHashGrid build_photon_hash_grid(std::vector<Photon> &&photons) {
     auto timer = empezar_timer();
+    PhotonHashGrid grid(std::move(photons), PHOTONMAP_GATHER_RADIUS);
+    print_photon_map_statistics("Hash grid", timer, grid);
 
-    Channel<RenderingMessagePhotonScattering> job_channel;
-    Channel<std::vector<Photon>> job_done_channel;
+    return grid;
+}
 
-    std::vector<std::thread> threads;
-    const auto processor_count = std::thread::hardware_concurrency();
-    for (size_t i = 0; i < processor_count; i++) {
-        threads.emplace_back(std::thread(rendering_thread_photonmapper, std::ref(scene), std::ref(job_channel), std::ref(job_done_channel), method));
-    }
-    std::cout << processor_count << " photon scattering threads started..." << std::endl;
+template <typename PhotonMap>
+IrradianceCache build_irradiance_cache(const PhotonMap &photons, PhotonmappingKernel kernel, size_t final_gather_rays) {
+    auto timer = empezar_timer();
+    IrradianceCache cache(photons, kernel, final_gather_rays);
+    print_photon_map_statistics("Irradiance cache", timer, cache);
+
+    return cache;
+}
 
-    send_rendering_jobs_photonmapper(scene, job_channel, photons_stored);
-    std::pair<std::vector<Photon>, int> result = track_rendering_jobs_photonmapper(job_done_channel);
-    stop_rendering_jobs_photonmapper(timer, job_channel, threads, processor_count);
+// Loads the photon map saved by a previous render with the same key, if reusing them. Otherwise (or if there is no
+// such file) scatters the photons, builds the map and, if reusing them, saves it for the next renders
+template <typename PhotonMap, typename Scattering>
+PhotonMap reusable_photon_map(const PhotonMapKey &key, bool reuse_photon_map, Scattering scatter) {
+    PhotonMap photons;
+    if (reuse_photon_map) {
+        auto timer = empezar_timer();
+        if (load_photon_map(key, photons)) {
+            std::cout << "Photon map loaded from " << key.file_name() << std::endl;
+            print_photon_map_statistics("Photon map", timer, photons);
+            return photons;
+        }
+    }
 
-    std::cout << "Scattered photons: " << result.first.size() << std::endl;
-    std::cout << "Number of walks: " << result.second << "/" << MAX_WALKS << std::endl << std::endl;
+    if constexpr (std::is_same_v<PhotonMap, PhotonHashGrid>) photons = build_photon_hash_grid(scatter());
+    else photons = build_photon_kdtree(scatter());
 
-    for (Photon &photon : result.first) {
-        photon.flux = 4*M_PI*photon.flux / result.second;
+    if (reuse_photon_map) {
+        if (save_photon_map(key, photons)) std::cout << "Photon map saved to " << key.file_name() << std::endl;
+        else std::cerr << "Could not save the photon map to " << key.file_name() << std::endl;
     }
 
-    return {result.first, PhotonAxisPosition()};
+    return photons;
 }
 
 
@@ -155,34 +231,38 @@ nn::KDTree<Photon, 3, PhotonAxisPosition> multithreaded_photon_scattering(const
  * Rendering based on the scattered photons
  *
  */
-void rendering_job_photonmapper_renderer(const Scene &scene, const nn::KDTree<Photon, 3, PhotonAxisPosition> &photons, std::vector<Vector3d> &img, size_t i, size_t j, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
+template <typename PhotonMap>
+void rendering_job_photonmapper_renderer(const Scene &scene, const PhotonMap &photons, std::vector<Vector3d> &img, size_t i, size_t j, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method, PhotonNeighbors &neighbors) {
     Vector3d temp_emission;
 
     for (size_t r = 0; r < scene.camera.rays_per_pixel; r++) {
         Ray ray = scene.camera.get_ray(i, j);
 
-        temp_emission = temp_emission + integrator_sample_photonmapping(scene, photons, ray, kernel, method);
+        temp_emission = temp_emission + integrator_sample_photonmapping(scene, photons, ray, kernel, method, neighbors);
     }
 
     img[i*scene.camera.width + j] = temp_emission / scene.camera.rays_per_pixel;
 }
 
-void rendering_thread_photonmapper_renderer(const Scene &scene, const nn::KDTree<Photon, 3, PhotonAxisPosition> &photons, std::vector<Vector3d> &img, Channel<RenderingMessage> &job_channel, Channel<int> &job_done_channel, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
+template <typename PhotonMap>
+void rendering_thread_photonmapper_renderer(const Scene &scene, const PhotonMap &photons, std::vector<Vector3d> &img, Channel<RenderingMessage> &job_channel, Channel<int> &job_done_channel, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
+    // Reused by all the photon gathers of this thread
+    PhotonNeighbors neighbors;
+
     while(true) {
         RenderingMessage job = job_channel.receive();
 
         if (job.stop) {
             break;
         } else {
-            rendering_job_photonmapper_renderer(scene, photons, img, job.i, job.j, kernel, method);
+            rendering_job_photonmapper_renderer(scene, photons, img, job.i, job.j, kernel, method, neighbors);
             job_done_channel.send(0);
         }
     }
 }
 
-void render_multithreaded_photonmapper(const Scene &scene, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
-    auto photons = multithreaded_photon_scattering(scene, method);
-
+template <typename PhotonMap>
+void render_photon_map(const Scene &scene, const PhotonMap &photons, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
     auto timer = empezar_timer();
 
     Channel<RenderingMessage> job_channel;
@@ -196,7 +276,7 @@ void render_multithreaded_photonmapper(const Scene &scene, PhotonmappingKernel k
     std::vector<std::thread> threads;
     const auto processor_count = std::thread::hardware_concurrency();
     for (size_t i = 0; i < processor_count; i++) {
-        threads.emplace_back(std::thread(rendering_thread_photonmapper_renderer, std::ref(scene), std::ref(photons), std::ref(img), std::ref(job_channel), std::ref(job_done_channel), kernel, method));
+        threads.emplace_back(std::thread(rendering_thread_photonmapper_renderer<PhotonMap>, std::ref(scene), std::ref(photons), std::ref(img), std::ref(job_channel), std::ref(job_done_channel), kernel, method));
     }
     std::cout << processor_count << " rendering threads started..." << std::endl;
 
@@ -205,4 +285,14 @@ void render_multithreaded_photonmapper(const Scene &scene, PhotonmappingKernel k
     stop_rendering_jobs(scene, timer, job_channel, img, threads, processor_count);
 }
 
+void render_multithreaded_photonmapper(const Scene &scene, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method,
+                                       PhotonMapBackend backend = KD_TREE, bool reuse_photon_map = false) {
+    PhotonMapKey key;
+    if (reuse_photon_map) key = photon_map_key(scene, MAX_WALKS, MAX_PHOTONS, MAX_SCATTERING_SECONDS, method, backend);
+    auto scatter = [&scene, method] { return multithreaded_photon_scattering(scene, method); };
+
+    if (backend == HASH_GRID) render_photon_map(scene, reusable_photon_map<PhotonHashGrid>(key, reuse_photon_map, scatter), kernel, method);
+    else render_photon_map(scene, reusable_photon_map<PhotonKDTree>(key, reuse_photon_map, scatter), kernel, method);
+}
+
 #endif //INFORMATICA_GRAFICA_PHOTONMAPPER_RENDERER_HPP
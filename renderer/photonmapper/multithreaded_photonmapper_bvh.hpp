@@ -29,7 +29,9 @@
 #include "../../lib/Photon.hpp"
 #include "../../photonmapping/photonmapping.hpp"
 #include "../../photonmapping/photonmapping_kdtree.hpp"
-#include "ThreadSafeCounter.hpp"
+#include "../../photonmapping/photonmapping_hashgrid.hpp"
+#include "../../photonmapping/photonmapping_file.hpp"
+#include "../../photonmapping/photonmapping_irradiance.hpp"
 #include "multithreaded_photonmapper.hpp"
 
 #ifdef benchmarking
@@ -45,58 +47,11 @@
  * Photon scattering
  *
  */
-std::vector<Photon> rendering_job_photonmapper_bvh(const Scene &scene, const BVH &bvh_tree, const Ray &ray, PhotonmappingDirectLightMethod method) {
-    std::vector<Photon> photons;
-    scatter_photons_bvh(scene, bvh_tree, ray, 0, photons, Vector3d(1, 1, 1), method);
-
-    return photons;
-}
-
-void rendering_thread_photonmapper_bvh(const Scene &scene, const BVH &bvh_tree, Channel<RenderingMessagePhotonScattering> &job_channel, Channel<std::vector<Photon>> &job_done_channel, PhotonmappingDirectLightMethod method) {
-    while(true) {
-        RenderingMessagePhotonScattering job = job_channel.receive();
-
-        if (job.stop) {
-            break;
-        } else {
-            if (job.photons_stored->get() < MAX_PHOTONS) {
-                auto photons = rendering_job_photonmapper_bvh(scene, bvh_tree, job.ray, method);
-                job.photons_stored->increment(photons.size());
-                job_done_channel.send(std::move(photons));
-            } else {
-                job_done_channel.send(std::vector<Photon>());
-            }
-        }
-    }
-}
-
-nn::KDTree<Photon, 3, PhotonAxisPosition> multithreaded_photon_scattering_bvh(const Scene &scene, const BVH &bvh_tree, PhotonmappingDirectLightMethod method) {
-    std::shared_ptr<ThreadSafeCounter> photons_stored = std::make_shared<ThreadSafeCounter>();
-
-    auto timer = empezar_timer();
-
-    Channel<RenderingMessagePhotonScattering> job_channel;
-    Channel<std::vector<Photon>> job_done_channel;
-
-    std::vector<std::thread> threads;
-    const auto processor_count = std::thread::hardware_concurrency();
-    for (size_t i = 0; i < processor_count; i++) {
-        threads.emplace_back(std::thread(rendering_thread_photonmapper_bvh, std::ref(scene), std::ref(bvh_tree), std::ref(job_channel), std::ref(job_done_channel), method));
-    }
-    std::cout << processor_count << " photon scattering threads started..." << std::endl;
-
-    send_rendering_jobs_photonmapper(scene, job_channel, photons_stored);
-    std::pair<std::vector<Photon>, int> result = track_rendering_jobs_photonmapper(job_done_channel);
-    stop_rendering_jobs_photonmapper(timer, job_channel, threads, processor_count);
-
-    std::cout << "Scattered photons: " << result.first.size() << std::endl;
-    std::cout << "Number of walks: " << result.second << "/" << MAX_WALKS << std::endl << std::endl;
-
-    for (Photon &photon : result.first) {
-        photon.flux = 4*M_PI*photon.flux / result.second;
-    }
-
-    return {result.first, PhotonAxisPosition()};
+std::vector<Photon> multithreaded_photon_scattering_bvh(const Scene &scene, const BVH &bvh_tree, PhotonmappingDirectLightMethod method) {
+    return multithreaded_photon_scattering(scene, bvh_tree.bounds(), {MAX_WALKS, MAX_PHOTONS, MAX_SCATTERING_SECONDS},
+                                           [&scene, &bvh_tree, method](const Ray &ray, std::vector<Photon> &photons) {
+        scatter_photons_bvh(scene, bvh_tree, ray, 0, photons, Vector3d(1, 1, 1), method);
+    });
 }
 
 
@@ -105,40 +60,38 @@ nn::KDTree<Photon, 3, PhotonAxisPosition> multithreaded_photon_scattering_bvh(co
  * Rendering based on the scattered photons
  *
  */
-void rendering_job_photonmapper_renderer_bvh(const Scene &scene, const BVH &bvh_tree, const nn::KDTree<Photon, 3, PhotonAxisPosition> &photons, std::vector<Vector3d> &img, size_t i, size_t j, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
+template <typename PhotonMap>
+void rendering_job_photonmapper_renderer_bvh(const Scene &scene, const BVH &bvh_tree, const PhotonMap &photons, std::vector<Vector3d> &img, size_t i, size_t j, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method, PhotonNeighbors &neighbors) {
     Vector3d temp_emission;
 
     for (size_t r = 0; r < scene.camera.rays_per_pixel; r++) {
         Ray ray = scene.camera.get_ray(i, j);
 
-        temp_emission = temp_emission + integrator_sample_photonmapping_bvh(scene, bvh_tree, photons, ray, kernel, method);
+        temp_emission = temp_emission + integrator_sample_photonmapping_bvh(scene, bvh_tree, photons, ray, kernel, method, neighbors);
     }
 
     img[i*scene.camera.width + j] = temp_emission / scene.camera.rays_per_pixel;
 }
 
-void rendering_thread_photonmapper_renderer_bvh(const Scene &scene, const BVH &bvh_tree, const nn::KDTree<Photon, 3, PhotonAxisPosition> &photons, std::vector<Vector3d> &img, Channel<RenderingMessage> &job_channel, Channel<int> &job_done_channel, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
+template <typename PhotonMap>
+void rendering_thread_photonmapper_renderer_bvh(const Scene &scene, const BVH &bvh_tree, const PhotonMap &photons, std::vector<Vector3d> &img, Channel<RenderingMessage> &job_channel, Channel<int> &job_done_channel, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
+    // Reused by all the photon gathers of this thread
+    PhotonNeighbors neighbors;
+
     while(true) {
         RenderingMessage job = job_channel.receive();
 
         if (job.stop) {
             break;
         } else {
-            rendering_job_photonmapper_renderer_bvh(scene, bvh_tree, photons, img, job.i, job.j, kernel, method);
+            rendering_job_photonmapper_renderer_bvh(scene, bvh_tree, photons, img, job.i, job.j, kernel, method, neighbors);
             job_done_channel.send(0);
         }
     }
 }
 
-void render_multithreaded_photonmapper_bvh(Scene &scene, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method, BvhMethod bvh_method) {
-    if (bvh_method == SORT) std::cout << "Building BVH tree for the scene with the sorting strategy..." << std::endl;
-    else if (bvh_method == CENTROID) std::cout << "Building BVH tree for the scene with the centroid strategy..." << std::endl;
-
-    BVH bvh_tree(scene, bvh_method);
-    scene.figures.clear();
-
-    auto photons = multithreaded_photon_scattering_bvh(scene, bvh_tree, method);
-
+template <typename PhotonMap>
+void render_photon_map_bvh(const Scene &scene, const BVH &bvh_tree, const PhotonMap &photons, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method) {
     auto timer = empezar_timer();
 
     Channel<RenderingMessage> job_channel;
@@ -152,7 +105,7 @@ void render_multithreaded_photonmapper_bvh(Scene &scene, PhotonmappingKernel ker
     std::vector<std::thread> threads;
     const auto processor_count = std::thread::hardware_concurrency();
     for (size_t i = 0; i < processor_count; i++) {
-        threads.emplace_back(std::thread(rendering_thread_photonmapper_renderer_bvh, std::ref(scene), std::ref(bvh_tree), std::ref(photons), std::ref(img), std::ref(job_channel), std::ref(job_done_channel), kernel, method));
+        threads.emplace_back(std::thread(rendering_thread_photonmapper_renderer_bvh<PhotonMap>, std::ref(scene), std::ref(bvh_tree), std::ref(photons), std::ref(img), std::ref(job_channel), std::ref(job_done_channel), kernel, method));
     }
     std::cout << processor_count << " rendering threads started..." << std::endl;
 
@@ -161,4 +114,35 @@ void render_multithreaded_photonmapper_bvh(Scene &scene, PhotonmappingKernel ker
     stop_rendering_jobs(scene, timer, job_channel, img, threads, processor_count);
 }
 
+// Renders the photon map itself or, with the irradiance cache, the cache built from it
+template <typename PhotonMap>
+void render_photon_map_estimate_bvh(const Scene &scene, const BVH &bvh_tree, const PhotonMap &photons, PhotonmappingKernel kernel,
+                                    PhotonmappingDirectLightMethod method, PhotonmappingEstimate estimate) {
+    if (estimate == DENSITY_ESTIMATION) {
+        render_photon_map_bvh(scene, bvh_tree, photons, kernel, method);
+    } else {
+        size_t final_gather_rays = estimate == FINAL_GATHER ? FINAL_GATHER_RAYS : 0;
+        render_photon_map_bvh(scene, bvh_tree, build_irradiance_cache(photons, kernel, final_gather_rays), kernel, method);
+    }
+}
+
+void render_multithreaded_photonmapper_bvh(Scene &scene, PhotonmappingKernel kernel, PhotonmappingDirectLightMethod method, BvhMethod bvh_method,
+                                           PhotonMapBackend backend = KD_TREE, bool reuse_photon_map = false,
+                                           PhotonmappingEstimate estimate = DENSITY_ESTIMATION) {
+    // Hashed before building the BVH, which takes the figures out of the scene
+    PhotonMapKey key;
+    if (reuse_photon_map) key = photon_map_key(scene, MAX_WALKS, MAX_PHOTONS, MAX_SCATTERING_SECONDS, method, backend);
+
+    if (bvh_method == SORT) std::cout << "Building BVH tree for the scene with the sorting strategy..." << std::endl;
+    else if (bvh_method == CENTROID) std::cout << "Building BVH tree for the scene with the centroid strategy..." << std::endl;
+
+    BVH bvh_tree(scene, bvh_method);
+    scene.figures.clear();
+
+    auto scatter = [&scene, &bvh_tree, method] { return multithreaded_photon_scattering_bvh(scene, bvh_tree, method); };
+
+    if (backend == HASH_GRID) render_photon_map_estimate_bvh(scene, bvh_tree, reusable_photon_map<PhotonHashGrid>(key, reuse_photon_map, scatter), kernel, method, estimate);
+    else render_photon_map_estimate_bvh(scene, bvh_tree, reusable_photon_map<PhotonKDTree>(key, reuse_photon_map, scatter), kernel, method, estimate);
+}
+
 #endif //INFORMATICA_GRAFICA_PHOTONMAPPER_RENDERER_BVH_HPP
@@ -0,0 +1,200 @@
+//
+// multithreaded_sppm_bvh.hpp
+//
+// Description:
+//  Stochastic progressive photon mapping runner (with BVH). Each pass traces one camera ray per pixel up to its
+//  first diffuse hit (its visible point), scatters a new batch of photons and gathers them at the visible points,
+//  shrinking the radius of each pixel as its photons accumulate. Only the photons of a pass are kept in memory, so
+//  the number of photons has no limit and the estimate converges as passes go on
+//
+// Authors:
+//  Samuel García
+//  Laura González
+//
+// Date:
+//  10/2026.
+//
+
+#ifndef INFORMATICA_GRAFICA_SPPM_RENDERER_BVH_HPP
+#define INFORMATICA_GRAFICA_SPPM_RENDERER_BVH_HPP
+
+#include <atomic>
+#include <limits>
+#include "camera.hpp"
+#include "../../lib/Scene.hpp"
+#include "renderer.hpp"
+#include "pathtracing.hpp"
+#include "../../lib/Photon.hpp"
+#include "../../photonmapping/photonmapping.hpp"
+#include "../../photonmapping/photonmapping_hashgrid.hpp"
+#include "multithreaded_photonmapper.hpp"
+
+#ifdef benchmarking
+#include "benchmarking.hpp"
+#endif
+
+#define SPPM_ITERATIONS 64
+#define SPPM_WALKS_PER_PASS 200000
+#define SPPM_INITIAL_RADIUS 0.05
+#define SPPM_ALPHA 0.7 // Fraction of the new photons kept on each pass, the lower the faster the radius shrinks
+
+// Statistics of a pixel along the passes
+struct SPPMPixel {
+    // Visible point of the current pass
+    bool has_visible_point = false;
+    Vector3d position;
+    Vector3d brdf;
+
+    double radius = SPPM_INITIAL_RADIUS;
+    double photons = 0;     // Accumulated number of photons (N)
+    Vector3d flux;          // Accumulated flux within the radius (tau)
+    Vector3d direct;        // Emission and direct light of all the passes
+};
+
+// Runs job(row, thread) for every row of the image, spread over all the threads
+template <typename RowJob>
+void sppm_parallel_rows(size_t rows, unsigned int processor_count, RowJob job) {
+    std::atomic<size_t> next_row{0};
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < processor_count; t++) {
+        threads.emplace_back([&, t] {
+            for (size_t row = next_row++; row < rows; row = next_row++) job(row, t);
+        });
+    }
+
+    for (auto &thread : threads) thread.join();
+}
+
+// Follows the camera ray through the specular and refractive bounces, as integrator_sample_photonmapping_bvh does,
+// up to its first diffuse hit, which becomes the visible point of the pixel. The emission and the direct light
+// found are added to the pixel
+void sppm_camera_pass(const Scene &scene, const BVH &bvh_tree, Ray ray, SPPMPixel &pixel) {
+    pixel.has_visible_point = false;
+
+    for (size_t number_of_bounces = 0; number_of_bounces <= MAX_NUM_OF_BOUNCES; number_of_bounces++) {
+#ifdef benchmarking
+        Benchmarking::count_ray_traced();
+#endif
+        HitRegister reg(bvh_tree.collides(ray));
+        if (!reg.hits) return;
+
+        const Material &material = surface_at_closest_hit(scene, ray, reg);
+        if (material.is_area_light) {
+            pixel.direct = pixel.direct + material.emission;
+            return;
+        }
+
+        Event event = russian_roulette(reg, material);
+        if (event == DIFFUSE) {
+            pixel.direct = pixel.direct + get_contributions_from_direct_lights_bvh(scene, bvh_tree, reg);
+
+            pixel.has_visible_point = true;
+            pixel.position = reg.n.origin.v;
+            pixel.brdf = reg.diffuse_coefficient / M_PI;
+            return;
+        } else if (event == ABSORPTION) {
+            return;
+        }
+
+        ray = generate_wi(event, reg, material, ray);
+    }
+}
+
+// Gathers the photons of this pass within the radius of the visible point, and shrinks the radius so that only
+// SPPM_ALPHA of them count towards the accumulated ones
+void sppm_photon_pass(const PhotonHashGrid &photons, SPPMPixel &pixel, PhotonNeighbors &neighbors) {
+    if (!pixel.has_visible_point) return;
+
+    // The grid gathers within the largest radius of all the pixels
+    photons.gather(pixel.position, neighbors);
+
+    double radius2 = pixel.radius * pixel.radius;
+    double new_photons = 0;
+    Vector3d new_flux;
+    for (const auto &neighbor : neighbors) {
+        if (neighbor.squared_distance < radius2) {
+            new_photons++;
+            new_flux = new_flux + neighbor.element->flux();
+        }
+    }
+    if (new_photons == 0) return;
+
+    double photons_kept = pixel.photons + SPPM_ALPHA * new_photons;
+    double new_radius = pixel.radius * sqrt(photons_kept / (pixel.photons + new_photons));
+
+    pixel.flux = (pixel.flux + new_flux.element_by_element(pixel.brdf)) * ((new_radius * new_radius) / radius2);
+    pixel.photons = photons_kept;
+    pixel.radius = new_radius;
+}
+
+// Radiance of every pixel after the given number of passes
+std::vector<Vector3d> multithreaded_sppm_bvh(const Scene &scene, const BVH &bvh_tree, size_t iterations) {
+    const Camera &camera = scene.camera;
+    std::vector<SPPMPixel> pixels(camera.width * camera.height);
+
+    const auto processor_count = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<PhotonNeighbors> neighbors(processor_count);
+    std::cout << processor_count << " rendering threads started..." << std::endl;
+
+    size_t total_photons = 0;
+    for (size_t iteration = 0; iteration < iterations; iteration++) {
+        sppm_parallel_rows(camera.height, processor_count, [&](size_t i, unsigned int /*thread*/) {
+            for (size_t j = 0; j < camera.width; j++) {
+                sppm_camera_pass(scene, bvh_tree, camera.get_ray(i, j), pixels[i * camera.width + j]);
+            }
+        });
+
+        // Only direct photons are left out, the camera pass already computes the direct light
+        std::vector<Photon> scattered = multithreaded_photon_scattering(
+                scene, bvh_tree.bounds(), {SPPM_WALKS_PER_PASS, std::numeric_limits<size_t>::max(), 0},
+                [&scene, &bvh_tree](const Ray &ray, std::vector<Photon> &photons) {
+                    scatter_photons_bvh(scene, bvh_tree, ray, 0, photons, Vector3d(1, 1, 1), NEXT_EVENT_ESTIMATION);
+                }, false);
+        total_photons += scattered.size();
+
+        double max_radius = 0;
+        for (const auto &pixel : pixels) max_radius = std::max(max_radius, pixel.radius);
+        PhotonHashGrid photons(std::move(scattered), max_radius);
+
+        sppm_parallel_rows(camera.height, processor_count, [&](size_t i, unsigned int thread) {
+            for (size_t j = 0; j < camera.width; j++) {
+                sppm_photon_pass(photons, pixels[i * camera.width + j], neighbors[thread]);
+            }
+        });
+
+        std::cout << '\r' << iteration + 1 << "/" << iterations << " passes (" << total_photons << " photons)";
+        std::flush(std::cout);
+    }
+
+    // Each pass scatters the whole power of the lights, so the photons of all of them add up to iterations times it
+    std::vector<Vector3d> img(pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++) {
+        const SPPMPixel &pixel = pixels[i];
+        img[i] = pixel.direct / (double) iterations
+               + pixel.flux / ((double) iterations * M_PI * pixel.radius * pixel.radius);
+    }
+    std::cout << std::endl;
+
+    return img;
+}
+
+void render_multithreaded_sppm_bvh(Scene &scene, BvhMethod bvh_method, size_t iterations = SPPM_ITERATIONS) {
+    if (bvh_method == SORT) std::cout << "Building BVH tree for the scene with the sorting strategy..." << std::endl;
+    else if (bvh_method == CENTROID) std::cout << "Building BVH tree for the scene with the centroid strategy..." << std::endl;
+
+    BVH bvh_tree(scene, bvh_method);
+    scene.figures.clear();
+
+    auto timer = empezar_timer();
+    std::vector<Vector3d> img = multithreaded_sppm_bvh(scene, bvh_tree, iterations);
+
+    std::cout << "Rendering time: " << time_elapsed(timer) << std::endl;
+#ifdef benchmarking
+    Benchmarking::print_statistics();
+#endif
+    std::cout << std::endl << "Tonemapping results..." << std::endl;
+    write_results(img, scene.camera);
+}
+
+#endif //INFORMATICA_GRAFICA_SPPM_RENDERER_BVH_HPP